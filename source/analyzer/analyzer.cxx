@@ -0,0 +1,113 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "analyzer.hxx"
+#include <algorithm>
+
+namespace {
+/// Unit vectors for up, right, down and left
+const int DIRECTIONS[4][2] = {{-1, 0}, {0, 1}, {1, 0}, {0, -1}};
+
+/// Entries done before the queue is compacted
+const size_t COMPACT = 4096;
+}
+
+const Analysis &Analyzer::analyze(const matrix &maze, int start_row, int start_col, int exit_row,
+                                  int exit_col, bool solution) {
+  analysis_ = Analysis();
+  const int rows = maze.rows();
+  const int cols = maze.cols();
+
+  /// Count the passages a word at a time, the BFS has to reach all of them
+  for (int row = 0; row < rows; row++) {
+    const BitMatrix::word *bits = maze.row(row);
+    for (int word = 0; word < maze.stride(); word++) analysis_.tiles += uint64_t(__builtin_popcountll(bits[word]));
+  }
+
+  if (solution) {
+    from_low_.reshape(rows, cols);
+    from_high_.reshape(rows, cols);
+    solution_.reshape(rows, cols);
+  }
+
+  if (start_row < 0 || start_row >= rows || start_col < 0 || start_col >= cols
+      || !maze.get(start_row, start_col))
+    return analysis_;
+
+  visited_.reshape(rows, cols);
+  queue_.clear();
+  head_ = 0;
+
+  visited_.set(start_row, start_col);
+  queue_.push_back({start_row, start_col, 0, 0});
+
+  uint64_t reached = 0, degrees = 0, ways = 0;
+  while (head_ < queue_.size()) {
+    const Entry tile = queue_[head_++];
+    reached++;
+
+    /// Find the neighbouring passages
+    int neighbours[4];
+    int degree = 0;
+    for (int direction = 0; direction < 4; direction++) {
+      const int row = tile.row + DIRECTIONS[direction][0];
+      const int col = tile.col + DIRECTIONS[direction][1];
+      if (row >= 0 && row < rows && col >= 0 && col < cols && maze.get(row, col))
+        neighbours[degree++] = direction;
+    }
+
+    degrees += uint64_t(degree);
+    if (degree == 1) {
+      analysis_.dead_ends++;
+    } else if (degree >= 3) {
+      analysis_.junctions++;
+      ways += uint64_t(degree - 1);
+    }
+
+    /// Corridors are runs of tiles with exactly two neighbours
+    const uint32_t corridor = degree == 2 ? tile.corridor + 1 : 0;
+    analysis_.longest_corridor = std::max<uint64_t>(analysis_.longest_corridor, corridor);
+
+    if (tile.row == exit_row && tile.col == exit_col) analysis_.solution = uint64_t(tile.distance) + 1;
+
+    for (int i = 0; i < degree; i++) {
+      const int direction = neighbours[i];
+      const int row = tile.row + DIRECTIONS[direction][0];
+      const int col = tile.col + DIRECTIONS[direction][1];
+      if (visited_.get(row, col)) continue;
+
+      visited_.set(row, col);
+      if (solution) {
+        if (direction & 1) from_low_.set(row, col);
+        if (direction & 2) from_high_.set(row, col);
+      }
+      queue_.push_back({row, col, tile.distance + 1, corridor});
+    }
+
+    /// Drop the done entries once they make up most of the queue, so it only
+    /// grows with the frontier and not with the maze
+    if (head_ >= COMPACT && head_ * 2 >= queue_.size()) {
+      queue_.erase(queue_.begin(), queue_.begin() + ptrdiff_t(head_));
+      head_ = 0;
+    }
+  }
+
+  /// A connected graph with one edge less than it has nodes is a tree
+  analysis_.perfect = reached == analysis_.tiles && degrees / 2 == reached - 1;
+  analysis_.branching = analysis_.junctions > 0 ? double(ways) / double(analysis_.junctions) : 0;
+
+  /// Walk back from the exit to the start
+  if (solution && analysis_.solution > 0) {
+    int row = exit_row;
+    int col = exit_col;
+    solution_.set(row, col);
+    while (row != start_row || col != start_col) {
+      const int direction = int(from_low_.get(row, col)) | int(from_high_.get(row, col)) << 1;
+      row -= DIRECTIONS[direction][0];
+      col -= DIRECTIONS[direction][1];
+      solution_.set(row, col);
+    }
+  }
+
+  return analysis_;
+}
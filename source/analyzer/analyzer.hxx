@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __ANALYZER_HXX__
+#define __ANALYZER_HXX__
+
+#include <cstdint>
+#include <vector>
+
+#include "../globals.hxx"
+
+/**
+ * Quality metrics of a maze, measured over its passage tiles
+ */
+struct Analysis {
+  /// Whether every passage is reachable and there are no loops
+  bool perfect = false;
+
+  /// Amount of passage tiles and tiles on the path from the start to the exit,
+  /// the path is 0 when the exit can't be reached
+  uint64_t tiles = 0, solution = 0;
+
+  /// Tiles with a single neighbour and tiles with three or more
+  uint64_t dead_ends = 0, junctions = 0;
+
+  /// Average amount of ways to go on at a junction
+  double branching = 0;
+
+  /// Longest run of tiles without a choice to make
+  uint64_t longest_corridor = 0;
+};
+
+/**
+ * Solves and measures mazes in a single breadth first pass. The scratch
+ * memory is kept between calls, so an analyzer can be reused for every maze
+ * of a worker.
+ */
+class Analyzer {
+ public:
+  /**
+   * Analyzes a maze
+   *
+   * @param maze     The maze, set bits are passages
+   * @param s_row    Tile row of the start
+   * @param s_col    Tile column of the start
+   * @param e_row    Tile row of the exit
+   * @param e_col    Tile column of the exit
+   * @param solution Whether to mark the solution path, see solution()
+   */
+  const Analysis &analyze(const matrix & /* maze */, int /* s_row */, int /* s_col */, int /* e_row */,
+                          int /* e_col */, bool /* solution */);
+
+  /**
+   * Tiles on the path from the start to the exit found by the last
+   * analyze() call that was asked to mark it
+   */
+  const BitMatrix &solution() const { return solution_; }
+
+ private:
+  /**
+   * A tile waiting in the queue along with its distance from the start and
+   * the length of the corridor leading up to it
+   */
+  struct Entry {
+    int row, col;
+    uint32_t distance, corridor;
+  };
+
+  /// Result of the last call
+  Analysis analysis_;
+
+  /// Breadth first queue, entries before head_ are done
+  std::vector<Entry> queue_;
+  size_t head_ = 0;
+
+  /// Tiles already queued
+  BitMatrix visited_;
+
+  /// Direction every tile was reached from, two bits split over two planes.
+  /// Only kept when the solution gets marked.
+  BitMatrix from_low_, from_high_;
+
+  /// Marked solution path
+  BitMatrix solution_;
+};
+
+#endif /// __ANALYZER_HXX__
@@ -0,0 +1,376 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../cmd/cmd.hxx"
+#include "../encoder/layer.hxx"
+#include "../generator/eller.hxx"
+#include "../generator/region.hxx"
+#include "../mapper/mapper.hxx"
+
+/**
+ * maze_bench times the generators, tmx serialization and the whole Mapper
+ * pipeline over a sweep of dimensions, thread counts and encodings, and
+ * writes the results as JSON so they can be compared from one commit to the
+ * next.
+ */
+
+namespace {
+/// Heap allocations made through operator new since the start of the process
+std::atomic<uint64_t> allocations{0}, allocated_bytes{0};
+
+/**
+ * Counts and makes an allocation, every replaced operator new goes through
+ * here so the forms can be mixed freely with the matching deletes
+ */
+void *allocate(size_t size, size_t alignment = 0) {
+  allocations++;
+  allocated_bytes += size;
+  if (size == 0) size = 1;
+  if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+
+  void *p = nullptr;
+  return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+}
+
+void *allocateOrThrow(size_t size, size_t alignment = 0) {
+  if (void *p = allocate(size, alignment)) return p;
+  throw std::bad_alloc();
+}
+}
+
+void *operator new(size_t size) { return allocateOrThrow(size); }
+void *operator new[](size_t size) { return allocateOrThrow(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+
+#if __cpp_sized_deallocation
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+#endif
+
+#if __cpp_aligned_new
+void *operator new(size_t size, std::align_val_t alignment) { return allocateOrThrow(size, size_t(alignment)); }
+void *operator new[](size_t size, std::align_val_t alignment) { return allocateOrThrow(size, size_t(alignment)); }
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+  return allocate(size, size_t(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+  return allocate(size, size_t(alignment));
+}
+
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+#endif
+
+namespace {
+/// Seed used for every case, so all runs do exactly the same work
+const uint64_t SEED = 1;
+
+/// GID written to passages
+const int GID = 5;
+
+/**
+ * Resets the peak resident set size of the process, Linux only
+ */
+void resetPeakRSS() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  if (clear_refs.is_open()) clear_refs << "5";
+}
+
+/**
+ * Timing, allocation and memory figures of a benchmark case
+ */
+struct Measurement {
+  double min = 0, median = 0, mean = 0;
+  uint64_t allocations = 0, allocated_bytes = 0;
+  long peak_rss_kb = 0;
+};
+
+/**
+ * Runs body warmup times untimed, then repeat times timed
+ */
+Measurement measure(int warmup, int repeat, const std::function<void()> &body) {
+  for (auto i = 0; i < warmup; i++) body();
+
+  resetPeakRSS();
+  const uint64_t allocations_before = allocations, bytes_before = allocated_bytes;
+
+  std::vector<double> seconds;
+  for (auto i = 0; i < repeat; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    body();
+    seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  Measurement m;
+  std::sort(seconds.begin(), seconds.end());
+  m.min = seconds.front();
+  m.median = seconds[seconds.size() / 2];
+  for (const auto s : seconds) m.mean += s / double(seconds.size());
+  m.allocations = (allocations - allocations_before) / uint64_t(repeat);
+  m.allocated_bytes = (allocated_bytes - bytes_before) / uint64_t(repeat);
+  m.peak_rss_kb = Stats::peakRSS();
+  return m;
+}
+
+/**
+ * Builds the JSON record of a case
+ */
+nlohmann::json record(const std::string &name, const Measurement &m, double cells, double bytes) {
+  nlohmann::json result;
+  result["name"] = name;
+  result["seconds"] = {{"min", m.min}, {"median", m.median}, {"mean", m.mean}};
+  result["cells"] = cells;
+  result["cells_per_second"] = m.median > 0 ? cells / m.median : 0.0;
+  result["output_bytes"] = bytes;
+  result["output_mb_per_second"] = m.median > 0 ? bytes / m.median / (1 << 20) : 0.0;
+  result["allocations"] = m.allocations;
+  result["allocated_bytes"] = m.allocated_bytes;
+  result["peak_rss_kb"] = m.peak_rss_kb;
+  return result;
+}
+
+/**
+ * Splits an encoding name into the layer encoding and compression
+ */
+bool parseEncoding(const std::string &encoding, bool &base64, Compression &compression) {
+  base64 = encoding != "csv";
+  if (encoding == "csv" || encoding == "base64") {
+    compression = Compression::NONE;
+    return true;
+  }
+  return Compressor::parse(encoding, compression) && Compressor::supported(compression);
+}
+
+/**
+ * Size of a file in bytes, 0 if it doesn't exist
+ */
+double fileSize(const std::string &path) {
+  struct stat info{};
+  return stat(path.c_str(), &info) == 0 ? double(info.st_size) : 0.0;
+}
+
+/**
+ * Runs body on a worker of pool, so it may use parallelFor
+ */
+void onWorker(WorkerPool &pool, const std::function<void(int)> &body) {
+  pool.submit(body);
+  pool.wait();
+}
+}
+
+int main(int argc, char **argv) {
+  cli::Parser parser(argc, argv);
+  parser.set_optional<std::vector<int>>("d", "dimensions", {15, 101, 1001, 5001, 20001}, "Maze dimensions to sweep");
+  parser.set_optional<std::vector<int>>("t", "threads", {1, WorkerPool::defaultWorkers()}, "Thread counts to sweep");
+  parser.set_optional<std::vector<std::string>>("e", "encodings", {"csv", "base64", "zlib", "gzip", "zstd"},
+                                                "Layer encodings to sweep, unsupported ones are skipped");
+  parser.set_optional<std::vector<std::string>>("p", "phases", {"generate", "serialize", "pipeline"},
+                                                "Phases to benchmark");
+  parser.set_optional<int>("r", "repeat", 3, "Timed runs per case");
+  parser.set_optional<int>("w", "warmup", 1, "Untimed runs per case");
+  parser.set_optional<int>("a", "amount", 0, "Mazes per pipeline run, 0 picks enough to keep every thread busy");
+  parser.set_optional<std::string>("o", "output", "maze_bench.json", "JSON report");
+  parser.set_optional<std::string>("l", "label", "", "Free form label stored in the report, e.g. a commit hash");
+  parser.run_and_exit_if_error();
+
+  const auto dimensions = parser.get<std::vector<int>>("d");
+  const auto threads = parser.get<std::vector<int>>("t");
+  const auto encodings = parser.get<std::vector<std::string>>("e");
+  const auto phases = parser.get<std::vector<std::string>>("p");
+  const int repeat = std::max(1, parser.get<int>("r"));
+  const int warmup = std::max(0, parser.get<int>("w"));
+  const auto has = [&phases](const char *phase) {
+    return std::find(phases.begin(), phases.end(), phase) != phases.end();
+  };
+
+  char dir_template[] = "/tmp/maze_bench.XXXXXX";
+  const char *dir = mkdtemp(dir_template);
+  if (dir == nullptr) {
+    std::cerr << "Could not create a temporary directory :(" << std::endl;
+    return 1;
+  }
+  const std::string tmx = std::string(dir) + "/bench.tmx";
+
+  nlohmann::json report;
+  report["label"] = parser.get<std::string>("l");
+  report["repeat"] = repeat;
+  report["warmup"] = warmup;
+  report["results"] = nlohmann::json::array();
+
+  /// Generation only, the parallel generator for every thread count
+  if (has("generate")) {
+    for (const auto d : dimensions) {
+      const double cells = double(d) * double(d);
+
+      for (const std::string algorithm : {"backtracker", "eller"}) {
+        std::cerr << "generate " << algorithm << " " << d << std::endl;
+        std::unique_ptr<IGenerator> generator;
+        if (algorithm == "eller") generator.reset(new EllerGenerator(d, d));
+        else generator.reset(new Generator(d));
+
+        const auto m = measure(warmup, repeat, [&]() {
+          generator->seed(SEED, 0);
+          generator->generateMaze(1, 1);
+        });
+        auto result = record("generate", m, cells, 0);
+        result["algorithm"] = algorithm;
+        result["dimensions"] = d;
+        result["threads"] = 1;
+        report["results"].push_back(result);
+      }
+
+      for (const auto t : threads) {
+        std::cerr << "generate parallel " << d << " x" << t << std::endl;
+        WorkerPool pool(t);
+
+        /// A RegionGenerator carves on behalf of the worker it was made for,
+        /// so every worker the run may land on gets its own
+        std::vector<std::unique_ptr<RegionGenerator>> generators(size_t(pool.size()));
+
+        const auto m = measure(warmup, repeat, [&]() {
+          onWorker(pool, [&](int worker) {
+            auto &generator = generators[size_t(worker)];
+            if (generator == nullptr) generator.reset(new RegionGenerator(d, d, pool, worker));
+            generator->seed(SEED, 0);
+            generator->generateMaze(1, 1);
+          });
+        });
+        auto result = record("generate", m, cells, 0);
+        result["algorithm"] = "parallel";
+        result["dimensions"] = d;
+        result["threads"] = t;
+        report["results"].push_back(result);
+      }
+    }
+  }
+
+  /// Serialization of an already generated maze on a single thread
+  if (has("serialize")) {
+    for (const auto d : dimensions) {
+      Generator generator(d);
+      generator.seed(SEED, 0);
+      const matrix maze = generator.generateMaze(1, 1);
+
+      TMXWriter writer;
+      std::vector<uint32_t> gids(static_cast<size_t>(d));
+      std::vector<uint8_t> scratch;
+
+      for (const auto &encoding : encodings) {
+        bool base64;
+        Compression compression;
+        if (!parseEncoding(encoding, base64, compression)) continue;
+        std::cerr << "serialize " << encoding << " " << d << std::endl;
+
+        double bytes = 0;
+        const auto m = measure(warmup, repeat, [&]() {
+          writer.open(tmx);
+          LayerEncoder encoder(writer, base64, compression, scratch);
+          for (int row = 0; row < d; row++) {
+            for (int col = 0; col < d; col++) gids[col] = maze.get(row, col) ? GID : 0;
+            encoder.writeRow(gids.data(), gids.size(), row == d - 1);
+          }
+          bytes = double(writer.written());
+          writer.close();
+        });
+        auto result = record("serialize", m, double(d) * double(d), bytes);
+        result["encoding"] = encoding;
+        result["dimensions"] = d;
+        result["threads"] = 1;
+        report["results"].push_back(result);
+      }
+    }
+    std::remove(tmx.c_str());
+  }
+
+  /// The whole Mapper::execute pipeline
+  if (has("pipeline")) {
+    for (const auto d : dimensions) {
+      for (const auto t : threads) {
+        for (const auto &encoding : encodings) {
+          bool base64;
+          Compression compression;
+          if (!parseEncoding(encoding, base64, compression)) continue;
+          std::cerr << "pipeline " << encoding << " " << d << " x" << t << std::endl;
+
+          /// Enough mazes for every thread to have something to do, without
+          /// taking forever on the large dimensions
+          const double maze_cells = double(d) * double(d);
+          int amount = parser.get<int>("a");
+          if (amount <= 0) amount = std::max(t, std::min(256, int(2e7 / maze_cells)));
+
+          nlohmann::json config = {
+              {TMX_NAME, "bench"}, {TMX_LAYER, "bench"}, {TMX_DIMENSIONS, d},
+              {TMX_DIMENSIONS_INCREMENT, 0}, {TMX_DIMENSIONS_REPEAT, 1}, {TMX_AMOUNT, amount},
+              {TMX_TILE_WIDTH, 108}, {TMX_TILE_HEIGHT, 108}, {TMX_TILE_SET, "bench.png"},
+              {TMX_TILE_SET_NAME, "bench"}, {TMX_GID_DEFAULT, GID}, {TMX_SEED, SEED},
+              {TMX_ENCODING, base64 ? "base64" : "csv"}, {TMX_COMPRESSION, Compressor::name(compression)}};
+          Mapper mapper(config);
+
+          /// Keep the mapper's progress output out of the way, it is only
+          /// shown when a run fails
+          std::ostringstream log;
+          mapper.setLog(log);
+          bool executed = true;
+          const auto m = measure(warmup, repeat, [&]() {
+            log.str(std::string());
+            executed = mapper.execute(dir, t) && executed;
+          });
+
+          double bytes = 0;
+          for (auto i = 1; i <= amount; i++) {
+            const std::string path = std::string(dir) + "/bench_" + std::to_string(i) + ".tmx";
+            bytes += fileSize(path);
+            std::remove(path.c_str());
+          }
+
+          /// Timings of a run that didn't produce its mazes mean nothing
+          if (!executed) {
+            rmdir(dir);
+            std::cerr << log.str() << std::endl << "Pipeline " << encoding << " " << d << " x" << t
+                      << " failed :(" << std::endl;
+            return 1;
+          }
+
+          auto result = record("pipeline", m, maze_cells * amount, bytes);
+          result["encoding"] = encoding;
+          result["dimensions"] = d;
+          result["threads"] = t;
+          result["amount"] = amount;
+          report["results"].push_back(result);
+        }
+      }
+    }
+  }
+
+  rmdir(dir);
+
+  std::ofstream output(parser.get<std::string>("o"));
+  output << report.dump(2) << std::endl;
+  if (!output.good()) {
+    std::cerr << "Could not write \"" << parser.get<std::string>("o") << "\" :(" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "base64.hxx"
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BASE64_SSSE3
+#include <immintrin.h>
+#endif
+
+namespace {
+/// Size of a block of raw bytes encoded at once by Base64Stream, a multiple of 3
+const size_t STREAM_BLOCK = 3 * 16384;
+
+const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+char *encodeScalar(const uint8_t *in, size_t size, char *out) {
+  size_t i = 0;
+
+  for (; i + 3 <= size; i += 3) {
+    const uint32_t group = uint32_t(in[i]) << 16 | uint32_t(in[i + 1]) << 8 | in[i + 2];
+    *out++ = ALPHABET[(group >> 18) & 63];
+    *out++ = ALPHABET[(group >> 12) & 63];
+    *out++ = ALPHABET[(group >> 6) & 63];
+    *out++ = ALPHABET[group & 63];
+  }
+
+  /// Pad the last incomplete group
+  if (i < size) {
+    const bool two = i + 1 < size;
+    const uint32_t group = uint32_t(in[i]) << 16 | (two ? uint32_t(in[i + 1]) << 8 : 0);
+    *out++ = ALPHABET[(group >> 18) & 63];
+    *out++ = ALPHABET[(group >> 12) & 63];
+    *out++ = two ? ALPHABET[(group >> 6) & 63] : '=';
+    *out++ = '=';
+  }
+
+  return out;
+}
+
+#ifdef BASE64_SSSE3
+/// Encodes 12 bytes into 16 characters per iteration, see Wojciech Muła's
+/// "Base64 encoding with SIMD instructions". Returns the amount of bytes
+/// consumed, always a multiple of 3, the rest is left to the scalar path.
+__attribute__((target("ssse3")))
+size_t encodeSSSE3(const uint8_t *in, size_t size, char *out) {
+  const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  const __m128i shift = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+  size_t i = 0;
+
+  /// Loads are 16 bytes wide, so stop while 4 spare bytes are still readable
+  for (; i + 16 <= size; i += 12, out += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    v = _mm_shuffle_epi8(v, shuffle);
+
+    /// Split every 3 bytes into four 6 bit indices
+    const __m128i t0 = _mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(v, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    const __m128i indices = _mm_or_si128(t1, t3);
+
+    /// Map the indices to the alphabet by adding a per range offset
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(less, _mm_set1_epi8(13)));
+    const __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(shift, range), indices);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), chars);
+  }
+
+  return i;
+}
+
+const bool HAS_SSSE3 = __builtin_cpu_supports("ssse3");
+#endif
+}
+
+char *Base64::encode(const uint8_t *in, size_t size, char *out) {
+#ifdef BASE64_SSSE3
+  if (HAS_SSSE3) {
+    const size_t done = encodeSSSE3(in, size, out);
+    return encodeScalar(in + done, size - done, out + done / 3 * 4);
+  }
+#endif
+  return encodeScalar(in, size, out);
+}
+
+Base64Stream::Base64Stream(TMXWriter &writer)
+    : writer_(writer), in_(STREAM_BLOCK), out_(Base64::encodedSize(STREAM_BLOCK)) {}
+
+void Base64Stream::write(const uint8_t *data, size_t size) {
+  while (size > 0) {
+    const size_t take = size < in_.size() - used_ ? size : in_.size() - used_;
+    std::memcpy(in_.data() + used_, data, take);
+    used_ += take;
+    data += take;
+    size -= take;
+
+    if (used_ == in_.size()) flush(false);
+  }
+}
+
+void Base64Stream::finish() { flush(true); }
+
+void Base64Stream::flush(bool last) {
+  /// Only whole groups can be encoded before the end of the stream
+  const size_t size = last ? used_ : used_ / 3 * 3;
+  const char *end = Base64::encode(in_.data(), size, out_.data());
+  writer_.write(out_.data(), size_t(end - out_.data()));
+
+  std::memmove(in_.data(), in_.data() + size, used_ - size);
+  used_ -= size;
+}
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __BASE64_HXX__
+#define __BASE64_HXX__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../writer/writer.hxx"
+
+/**
+ * Standard base64 (RFC 4648) encoder. Uses SSSE3 to encode 12 bytes per
+ * instruction sequence when the CPU supports it.
+ */
+class Base64 {
+ public:
+  /**
+   * Amount of characters needed to encode size bytes, padding included
+   */
+  static size_t encodedSize(size_t size) { return (size + 2) / 3 * 4; }
+
+  /**
+   * Encodes size bytes from in to out, padding the last group if needed.
+   * out must hold at least encodedSize(size) characters.
+   *
+   * @return Pointer past the last written character
+   */
+  static char *encode(const uint8_t *in, size_t size, char *out);
+};
+
+/**
+ * Base64 encodes a byte stream into a TMXWriter through a fixed size buffer,
+ * so arbitrarily large layers can be encoded in bounded memory.
+ */
+class Base64Stream {
+ public:
+  /**
+   * Constructor
+   *
+   * @param writer The writer receiving the encoded characters
+   */
+  explicit Base64Stream(TMXWriter &writer);
+
+  /**
+   * Appends bytes to the stream
+   */
+  void write(const uint8_t *data, size_t size);
+
+  /**
+   * Encodes whatever is left, including the padding
+   */
+  void finish();
+
+ private:
+  /**
+   * Encodes the buffered bytes, keeping the bytes of an incomplete group
+   */
+  void flush(bool last);
+
+  /// Destination of the encoded characters
+  TMXWriter &writer_;
+
+  /// Raw bytes waiting to be encoded and their encoded form
+  std::vector<uint8_t> in_;
+  std::vector<char> out_;
+
+  /// Amount of buffered raw bytes
+  size_t used_ = 0;
+};
+
+#endif /// __BASE64_HXX__
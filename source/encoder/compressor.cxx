@@ -0,0 +1,159 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "compressor.hxx"
+#include <stdexcept>
+
+#ifdef MAZE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef MAZE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+#ifdef MAZE_HAVE_ZLIB
+void appendBigEndian(std::string &out, uint32_t value) {
+  out += char(value >> 24);
+  out += char(value >> 16);
+  out += char(value >> 8);
+  out += char(value);
+}
+
+void appendLittleEndian(std::string &out, uint32_t value) {
+  out += char(value);
+  out += char(value >> 8);
+  out += char(value >> 16);
+  out += char(value >> 24);
+}
+
+void deflateChunk(const uint8_t *data, size_t size, bool last, std::string &out) {
+  z_stream stream{};
+
+  /// Negative window bits produce raw deflate data without a zlib header
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw std::runtime_error("deflate can't be initialized");
+  out.resize(deflateBound(&stream, uLong(size)) + 16);
+
+  stream.next_in = const_cast<Bytef *>(data);
+  stream.avail_in = uInt(size);
+  stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+  stream.avail_out = uInt(out.size());
+
+  /// A sync flush ends the chunk on a byte boundary without marking the
+  /// final block, so the next chunk can simply be appended
+  const int result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  /// The output buffer is bound to hold everything, so anything short of a
+  /// finished stream or a fully flushed chunk is an error
+  if (result != (last ? Z_STREAM_END : Z_OK) || stream.avail_in != 0)
+    throw std::runtime_error("deflate failed");
+}
+#endif
+}
+
+bool Compressor::parse(const std::string &name, Compression &compression) {
+  if (name.empty() || name == "none") compression = Compression::NONE;
+  else if (name == "zlib") compression = Compression::ZLIB;
+  else if (name == "gzip") compression = Compression::GZIP;
+  else if (name == "zstd") compression = Compression::ZSTD;
+  else return false;
+
+  return true;
+}
+
+const char *Compressor::name(Compression compression) {
+  switch (compression) {
+    case Compression::ZLIB: return "zlib";
+    case Compression::GZIP: return "gzip";
+    case Compression::ZSTD: return "zstd";
+    default: return "none";
+  }
+}
+
+bool Compressor::supported(Compression compression) {
+  switch (compression) {
+    case Compression::NONE: return true;
+#ifdef MAZE_HAVE_ZLIB
+    case Compression::ZLIB:
+    case Compression::GZIP: return true;
+#endif
+#ifdef MAZE_HAVE_ZSTD
+    case Compression::ZSTD: return true;
+#endif
+    default: return false;
+  }
+}
+
+void Compressor::compress(Compression compression, const uint8_t *data, size_t size,
+                          bool last, Chunk &chunk) {
+  chunk.size = size;
+
+  switch (compression) {
+#ifdef MAZE_HAVE_ZLIB
+    case Compression::ZLIB:
+      chunk.checksum = uint32_t(adler32(adler32(0, Z_NULL, 0), data, uInt(size)));
+      deflateChunk(data, size, last, chunk.data);
+      break;
+    case Compression::GZIP:
+      chunk.checksum = uint32_t(crc32(crc32(0, Z_NULL, 0), data, uInt(size)));
+      deflateChunk(data, size, last, chunk.data);
+      break;
+#endif
+#ifdef MAZE_HAVE_ZSTD
+    case Compression::ZSTD:
+    {
+      chunk.data.resize(ZSTD_compressBound(size));
+      const size_t written = ZSTD_compress(&chunk.data[0], chunk.data.size(), data, size, ZSTD_CLEVEL_DEFAULT);
+      if (ZSTD_isError(written)) throw std::runtime_error(std::string("zstd failed, ") + ZSTD_getErrorName(written));
+      chunk.data.resize(written);
+      break;
+    }
+#endif
+    default:
+      chunk.data.assign(reinterpret_cast<const char *>(data), size);
+      break;
+  }
+}
+
+std::string Compressor::header(Compression compression) {
+  switch (compression) {
+    /// Deflate with a 32K window and the default compression level
+    case Compression::ZLIB: return std::string("\x78\x9c", 2);
+
+    /// Deflate, no flags, no modification time, unknown operating system
+    case Compression::GZIP: return std::string("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff", 10);
+
+    default: return std::string();
+  }
+}
+
+std::string Compressor::trailer(Compression compression, const std::vector<Chunk> &chunks) {
+  std::string trailer;
+
+#ifdef MAZE_HAVE_ZLIB
+  if (compression == Compression::ZLIB) {
+    uLong checksum = adler32(0, Z_NULL, 0);
+    for (const auto &chunk : chunks)
+      checksum = adler32_combine(checksum, chunk.checksum, z_off_t(chunk.size));
+    appendBigEndian(trailer, uint32_t(checksum));
+  } else if (compression == Compression::GZIP) {
+    uLong checksum = crc32(0, Z_NULL, 0);
+    size_t size = 0;
+    for (const auto &chunk : chunks) {
+      checksum = crc32_combine(checksum, chunk.checksum, z_off_t(chunk.size));
+      size += chunk.size;
+    }
+    appendLittleEndian(trailer, uint32_t(checksum));
+    appendLittleEndian(trailer, uint32_t(size));
+  }
+#else
+  (void) compression;
+  (void) chunks;
+#endif
+
+  return trailer;
+}
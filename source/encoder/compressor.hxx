@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __COMPRESSOR_HXX__
+#define __COMPRESSOR_HXX__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Layer compressions supported by Tiled
+ */
+enum class Compression { NONE, ZLIB, GZIP, ZSTD };
+
+/**
+ * Compresses a layer as independent chunks that are stitched back together
+ * into a single stream, so the chunks can be compressed on different threads
+ * while the result is still an ordinary zlib, gzip or zstd stream.
+ *
+ * zlib and gzip chunks are raw deflate data ending on a byte boundary (every
+ * chunk but the last is sync flushed) and their checksums are combined. zstd
+ * chunks are complete frames, which zstd decoders read back to back.
+ */
+class Compressor {
+ public:
+  /**
+   * A single compressed chunk
+   */
+  struct Chunk {
+    /// Compressed bytes
+    std::string data;
+
+    /// Checksum of the uncompressed bytes, adler32 for zlib and crc32 for gzip
+    uint32_t checksum = 0;
+
+    /// Amount of uncompressed bytes
+    size_t size = 0;
+  };
+
+  /**
+   * Parses a compression name as used by Tiled, "" and "none" mean no compression
+   *
+   * @return false if the name is unknown
+   */
+  static bool parse(const std::string &name, Compression &compression);
+
+  /**
+   * Name of the compression as used in the tmx "compression" attribute
+   */
+  static const char *name(Compression compression);
+
+  /**
+   * Whether this build can produce the compression
+   */
+  static bool supported(Compression compression);
+
+  /**
+   * Compresses a chunk
+   *
+   * @param compression The compression to use, must be supported
+   * @param data        Uncompressed bytes
+   * @param size        Amount of uncompressed bytes
+   * @param last        Whether this is the last chunk of the stream
+   * @param chunk       Receives the compressed chunk
+   * @throws std::runtime_error if the compression library fails
+   */
+  static void compress(Compression compression, const uint8_t *data, size_t size,
+                       bool last, Chunk &chunk);
+
+  /**
+   * Bytes to write before the first chunk
+   */
+  static std::string header(Compression compression);
+
+  /**
+   * Bytes to write after the last chunk
+   *
+   * @param chunks Every chunk of the stream, in order
+   */
+  static std::string trailer(Compression compression, const std::vector<Chunk> &chunks);
+};
+
+#endif /// __COMPRESSOR_HXX__
@@ -0,0 +1,67 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "layer.hxx"
+#include <algorithm>
+
+constexpr size_t LayerEncoder::CHUNK_SIZE;
+
+LayerEncoder::LayerEncoder(TMXWriter &writer, bool base64, Compression compression,
+                           std::vector<uint8_t> &scratch)
+    : writer_(writer), base64_(base64), compression_(compression), raw_(scratch), stream_(writer) {
+  if (compression_ != Compression::NONE) {
+    const std::string header = Compressor::header(compression_);
+    stream_.write(reinterpret_cast<const uint8_t *>(header.data()), header.size());
+  }
+}
+
+void LayerEncoder::storeLittleEndian(const uint32_t *gids, size_t count, uint8_t *out) {
+  for (size_t i = 0; i < count; i++, out += 4) {
+    out[0] = uint8_t(gids[i]);
+    out[1] = uint8_t(gids[i] >> 8);
+    out[2] = uint8_t(gids[i] >> 16);
+    out[3] = uint8_t(gids[i] >> 24);
+  }
+}
+
+void LayerEncoder::writeRow(const uint32_t *gids, size_t count, bool last) {
+  if (!base64_) {
+    writer_.writeCSVRow(gids, count, last);
+    return;
+  }
+
+  /// Rows are never split over two chunks
+  const size_t bytes = count * 4;
+  if (raw_.size() < bytes || raw_.size() < CHUNK_SIZE) raw_.resize(std::max(bytes, CHUNK_SIZE));
+  if (used_ + bytes > raw_.size()) flushChunk(false);
+
+  storeLittleEndian(gids, count, raw_.data() + used_);
+  used_ += bytes;
+
+  if (last) {
+    flushChunk(true);
+
+    if (compression_ != Compression::NONE) {
+      const std::string trailer = Compressor::trailer(compression_, chunks_);
+      stream_.write(reinterpret_cast<const uint8_t *>(trailer.data()), trailer.size());
+    }
+    stream_.finish();
+    writer_.write("\n", 1);
+  }
+}
+
+void LayerEncoder::flushChunk(bool last) {
+  if (compression_ == Compression::NONE) {
+    stream_.write(raw_.data(), used_);
+  } else {
+    Compressor::Chunk chunk;
+    Compressor::compress(compression_, raw_.data(), used_, last, chunk);
+    stream_.write(reinterpret_cast<const uint8_t *>(chunk.data.data()), chunk.data.size());
+
+    chunk.data.clear();
+    chunk.data.shrink_to_fit();
+    chunks_.push_back(std::move(chunk));
+  }
+
+  used_ = 0;
+}
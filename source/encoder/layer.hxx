@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __LAYER_HXX__
+#define __LAYER_HXX__
+
+#include <cstdint>
+#include <vector>
+
+#include "../writer/writer.hxx"
+#include "base64.hxx"
+#include "compressor.hxx"
+
+/**
+ * Encodes the data of a tile layer row by row in any of the supported
+ * encodings. Compressed layers are compressed one chunk at a time, so memory
+ * stays bounded by the chunk size however many rows are written.
+ */
+class LayerEncoder {
+ public:
+  /// Amount of uncompressed layer data compressed as a single chunk
+  static constexpr size_t CHUNK_SIZE = 1 << 20;
+
+  /**
+   * Constructor
+   *
+   * @param writer      The writer receiving the layer data
+   * @param base64      Whether to base64 encode the data instead of using csv
+   * @param compression Compression of base64 data
+   * @param scratch     Buffer holding the raw data of a chunk, reused across layers
+   */
+  LayerEncoder(TMXWriter &writer, bool base64, Compression compression,
+               std::vector<uint8_t> &scratch);
+
+  /**
+   * Appends a row of GIDs
+   *
+   * @param gids  The GIDs of the row
+   * @param count Amount of GIDs in the row
+   * @param last  Whether this is the last row of the layer
+   */
+  void writeRow(const uint32_t *gids, size_t count, bool last);
+
+  /**
+   * Tiled expects GIDs as little-endian unsigned 32 bit integers
+   */
+  static void storeLittleEndian(const uint32_t *gids, size_t count, uint8_t *out);
+
+ private:
+  /**
+   * Compresses and writes the buffered chunk
+   */
+  void flushChunk(bool last);
+
+  /// Destination of the layer data
+  TMXWriter &writer_;
+
+  /// Layer encoding
+  bool base64_;
+  Compression compression_;
+
+  /// Raw bytes of the chunk being filled and how many are used
+  std::vector<uint8_t> &raw_;
+  size_t used_ = 0;
+
+  /// Base64 encoder
+  Base64Stream stream_;
+
+  /// Chunks written so far, only their checksums and sizes are kept
+  std::vector<Compressor::Chunk> chunks_;
+};
+
+#endif /// __LAYER_HXX__
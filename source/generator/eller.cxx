@@ -0,0 +1,153 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE for details)
+
+#include "eller.hxx"
+#include <algorithm>
+
+#include "../stats/stats.hxx"
+
+EllerGenerator::EllerGenerator(int width, int height) {
+  seed(entropySeed(), 0);
+  resize(width, height);
+}
+
+void EllerGenerator::resize(int width, int height) {
+  IGenerator::resize(width, height);
+
+  const size_t cells = size_t(cell_cols_);
+  sets_.resize(cells);
+  parent_.resize(cells);
+  last_.resize(cells);
+  remap_.resize(cells);
+  has_down_.resize(cells);
+  down_.resize(cells);
+  rows_.reshape(2, width_);
+}
+
+void EllerGenerator::seed(uint64_t seed, uint64_t stream) {
+  IGenerator::seed(seed, stream);
+  bits_left_ = 0;
+}
+
+bool EllerGenerator::bit() {
+  if (bits_left_ == 0) {
+    bits_ = random_.next();
+    bits_left_ = 64;
+  }
+
+  const bool b = (bits_ & 1) != 0;
+  bits_ >>= 1;
+  bits_left_--;
+  return b;
+}
+
+int EllerGenerator::find(int set) {
+  while (parent_[set] != set) {
+    parent_[set] = parent_[parent_[set]];
+    set = parent_[set];
+  }
+  return set;
+}
+
+matrix EllerGenerator::generateMaze(int start_row, int start_col) {
+  const Stopwatch allocate;
+  matrix generated_maze(height_, width_);
+  const double allocated = allocate.seconds();
+
+  generateRows(start_row, start_col, [&generated_maze](int row, const BitMatrix::word *bits) {
+    std::copy(bits, bits + generated_maze.stride(), generated_maze.row(row));
+  });
+  counters_.allocate = allocated;
+  return generated_maze;
+}
+
+void EllerGenerator::generateRows(int, int, const RowCallback &callback) {
+  const int cols = cell_cols_;
+  int out_row = 0;
+  counters_ = Counters();
+  if (height_ <= 0) return;
+
+  /// Every cell is carved exactly once and there is nothing to backtrack
+  counters_.cells = uint64_t(cell_rows_) * uint64_t(cell_cols_);
+
+  /// Hands a row of rows_ to the callback, opening the exit on the way
+  auto emit = [&](int row) {
+    if (out_row == exitRow() && cols > 0) rows_.set(row, exitCol());
+    callback(out_row++, rows_.row(row));
+  };
+
+  /// Top border
+  rows_.clear();
+  emit(0);
+
+  /// Every cell of the first row starts in its own set
+  for (auto c = 0; c < cols; c++) sets_[c] = c;
+
+  for (auto r = 0; r < cell_rows_; r++) {
+    const bool last = r == cell_rows_ - 1;
+    rows_.clear();
+
+    /// Set ids are compacted to [0, cols) for every row, so the forest can
+    /// simply be reset
+    for (auto c = 0; c < cols; c++) {
+      parent_[c] = c;
+      rows_.set(0, 2 * c + 1);
+    }
+
+    /// Randomly join neighbours that aren't connected yet. The last row has
+    /// to join them all, otherwise parts of the maze would be cut off.
+    for (auto c = 0; c + 1 < cols; c++) {
+      const int a = find(sets_[c]);
+      const int b = find(sets_[c + 1]);
+      if (a != b && (last || bit())) {
+        parent_[b] = a;
+        rows_.set(0, 2 * c + 2);
+      }
+    }
+
+    if (!last) {
+      for (auto c = 0; c < cols; c++) {
+        sets_[c] = find(sets_[c]);
+        has_down_[c] = 0;
+      }
+
+      /// Randomly carve down...
+      for (auto c = 0; c < cols; c++) {
+        down_[c] = uint8_t(bit());
+        if (down_[c]) has_down_[sets_[c]] = 1;
+        last_[sets_[c]] = c;
+      }
+
+      /// ...making sure every set goes down at least once
+      for (auto c = 0; c < cols; c++) {
+        const int set = sets_[c];
+        if (!has_down_[set]) {
+          down_[last_[set]] = 1;
+          has_down_[set] = 1;
+        }
+      }
+
+      /// Cells below keep the set of the cell above them, all others start a
+      /// new one
+      std::fill(remap_.begin(), remap_.end(), -1);
+      int next = 0;
+      for (auto c = 0; c < cols; c++) {
+        if (!down_[c]) continue;
+        rows_.set(1, 2 * c + 1);
+        if (remap_[sets_[c]] < 0) remap_[sets_[c]] = next++;
+        sets_[c] = remap_[sets_[c]];
+      }
+      for (auto c = 0; c < cols; c++)
+        if (!down_[c]) sets_[c] = next++;
+    }
+
+    emit(0);
+    if (!last) emit(1);
+  }
+
+  /// Bottom border and any rows left over by an even height
+  while (out_row < height_) {
+    rows_.clear();
+    emit(0);
+  }
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __ELLER_HXX__
+#define __ELLER_HXX__
+
+#include "generator.hxx"
+
+/**
+ * Generates perfect mazes with Eller's algorithm. Cells are carved one row at
+ * a time while tracking which cells of the current row are already connected,
+ * so a maze of any height only needs O(width) memory when streamed with
+ * generateRows().
+ */
+class EllerGenerator : public IGenerator {
+ public:
+  /**
+   * Constructor
+   */
+  EllerGenerator(int /* width */, int /* height */);
+
+  /**
+   * Changes the dimensions of the mazes produced by this generator
+   */
+  void resize(int /* width */, int /* height */) override;
+
+  /**
+   * Seeds the generator for the next maze
+   */
+  void seed(uint64_t /* seed */, uint64_t /* stream */) override;
+
+  /**
+   * Generates the whole maze in memory. The start cell is ignored, every cell
+   * of a perfect maze is reachable from it anyway.
+   */
+  matrix generateMaze(int /* s_row */, int /* s_col */) override;
+
+  /**
+   * Streams the maze row by row, only the rows being carved are kept in memory
+   */
+  void generateRows(int /* s_row */, int /* s_col */, const RowCallback& /* callback */) override;
+
+  /**
+   * Eller's algorithm always streams
+   */
+  bool streaming() const override { return true; }
+
+ private:
+  /**
+   * A random bit, 64 bits are drawn at once
+   */
+  bool bit();
+
+  /**
+   * Finds the representative of a set, halving the path on the way
+   */
+  int find(int /* set */);
+
+  /// Random bits not used yet
+  uint64_t bits_ = 0;
+  int bits_left_ = 0;
+
+  /// Set of every cell in the current row and the set union-find forest
+  std::vector<int> sets_, parent_;
+
+  /// Per set: the last cell seen, whether it already goes down, and its id in
+  /// the next row
+  std::vector<int> last_, remap_;
+  std::vector<uint8_t> has_down_;
+
+  /// Whether each cell of the current row is connected to the one below
+  std::vector<uint8_t> down_;
+
+  /// The row of cells being carved and the row of walls below it
+  BitMatrix rows_;
+};
+
+#endif /// __ELLER_HXX__
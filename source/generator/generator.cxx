@@ -2,182 +2,137 @@
 /// This code is licensed under MIT license (see LICENSE for details)
 
 #include "generator.hxx"
+#include <random>
 
-Generator::Generator(int dimensions)
-    : gen_(rd_()),
-      matrix_(dimensions),
-      dimensions_(dimensions) {
+#include "../stats/stats.hxx"
 
-  /// Number can't be even so this will automatically be incremented
-  if (matrix_ % 2 == 0)matrix_++;
+constexpr uint64_t Generator::MAX_CELLS;
 
-  /// Cut the cut the matrix in half to allocate the right amount of memory for
-  /// the stack
-  matrix_ = (matrix_ - 1) / 2;
-  initializeStack();
+namespace {
+/// Unit vectors for up, right, down and left
+const int DIRECTIONS[4][2] = {{-1, 0}, {0, 1}, {1, 0}, {0, -1}};
+}
 
-  /// Initialize the neighboring matrix
-  initializeNMatrix();
+void IGenerator::resize(int width, int height) {
+  width_ = width;
+  height_ = height;
+  cell_rows_ = height > 2 && width > 2 ? (height - 1) / 2 : 0;
+  cell_cols_ = height > 2 && width > 2 ? (width - 1) / 2 : 0;
 }
 
-Generator::~Generator() {
-  delete[] stack_;
-  delete[] n_matrix_;
+void IGenerator::seed(uint64_t seed, uint64_t stream) {
+  seed_ = seed;
+  stream_ = stream;
+  random_.reset(seed, stream);
 }
 
-int **Generator::initializeMatrix() {
-  /// Creating empty maze
-  auto empty_maze = new int *[dimensions_];
-  for (auto i = 0; i < dimensions_; i++)
-  {
-      empty_maze[i] = new int[dimensions_];
-      for (auto j = 0; j < dimensions_; j++)
-          empty_maze[i][j] = 0;
-  }
+uint64_t IGenerator::entropySeed() {
+  std::random_device rd;
+  return (uint64_t(rd()) << 32) | rd();
+}
 
-  return empty_maze;
+void IGenerator::generateRows(int start_row, int start_col, const RowCallback &callback) {
+  const matrix maze = generateMaze(start_row, start_col);
+  for (int row = 0; row < maze.rows(); row++) callback(row, maze.row(row));
 }
 
-void Generator::initializeNMatrix() {
-  n_matrix_ = new int *[4];
-  for (auto i = 0; i < 4; i++) n_matrix_[i] = new int[3];
-
-  /// Set initial for matrix
-  /// Unit vectors for left, up, right and down
-  n_matrix_[0][0] = -1;
-  n_matrix_[0][1] = 0;
-  n_matrix_[1][0] = 0;
-  n_matrix_[1][1] = 1;
-  n_matrix_[2][0] = 1;
-  n_matrix_[2][1] = 0;
-  n_matrix_[3][0] = 0;
-  n_matrix_[3][1] = -1;
+Generator::Generator(int dimensions) {
+  seed(entropySeed(), 0);
+  resize(dimensions);
 }
 
-void Generator::initializeStack() {
-  const int s = matrix_ * matrix_ * 100;
-  stack_ = new int *[s];
-  for (auto i = 0; i < s; i++) stack_[i] = new int[2];
+Generator::~Generator() = default;
 
-  /// Add 2 to the matrix to assure we don't run our of bounds
-  matrix_ += 2;
-}
+void Generator::resize(int dimensions) { resize(dimensions, dimensions); }
 
-void Generator::push(int row, int col) {
-  /// Stack is a stack of tuples which represent x, y coordinates which are on
-  if (stack_index_ >= 0) {
-    stack_[stack_index_][0] = row;
-    stack_[stack_index_][1] = col;
-  }
-  stack_index_++;
+void Generator::push(uint32_t cell) {
+  stack_[stack_index_++] = cell;
 }
 
 void Generator::pop(int *row, int *col) {
   stack_index_--;
-  /// See comment for push
-  if (stack_index_ >= 0) {
-    *row = stack_[stack_index_][0];
-    *col = stack_[stack_index_][1];
+
+  /// Resume from the cell below the popped one, if there is any
+  if (stack_index_ > 0) {
+    const uint32_t cell = stack_[stack_index_ - 1];
+    *row = int(cell / uint32_t(region_cols_));
+    *col = int(cell % uint32_t(region_cols_));
   }
 }
 
-int **Generator::generateMaze(int start_row, int start_col, const int gid_default) {
-  /// Initialize empty maze and visited matrix
-  auto generated_maze = initializeMatrix();
-  generated_maze[start_row][start_col] = gid_default;
-  auto visited = initializeMatrix();
-  visited[start_row][start_col] = 1;
-  push(start_row, start_col);
+matrix Generator::generateMaze(int start_row, int start_col) {
+  counters_ = Counters();
+  const Stopwatch allocate;
+  matrix generated_maze(height_, width_);
+  counters_.allocate = allocate.seconds();
+  if (cell_rows_ == 0) return generated_maze;
 
-  /// Creating Temp copy of the initial values
-  int t_row = start_row;
-  int t_col = start_col;
+  /// Work in cell space, cell (row, col) is tile (2 * row + 1, 2 * col + 1)
+  carve(generated_maze, 0, 0, cell_rows_, cell_cols_, (start_row - 1) / 2, (start_col - 1) / 2);
 
-  while (stack_index_ != 0) {
-    int row, col, n_index = 0, k = 0, counter = 0;
-
-    /// Pop references to the next values and use those to find our next steps
-    pop(&row, &col);
-    start_row = row;
-    start_col = col;
-
-    /// Update the cell to visited
-    visited[row][col] = 1;
-
-    while (k == 0 && counter < 4) {
-      /// Create our random distribution list for a random number between 1 & 99999;
-      std::uniform_int_distribution<> dis(1, 99999);
-      n_index = dis(gen_) % (6342 - dis(gen_) % 2243);
-      n_index %= 4;
-
-      /// Update row and col to the nearest_matrix with the random index
-      row = start_row + n_matrix_[n_index][0];
-      col = start_col + n_matrix_[n_index][1];
-      n_matrix_[n_index][2] = 1;
-
-      /// Where the magic happens
-      if (!(row < 0 || col < 0 || (row == 0 || col == 0 || row == matrix_ - 1
-          || col == matrix_ - 1))) {
-        if (visited[row][col] == 0) {
-          if (start_row == row && start_col != col) {
-            if (start_col > col) {
-              generated_maze[t_row][t_col - 1] = gid_default;
-              generated_maze[t_row][t_col - 2] = gid_default;
-              t_col -= 2;
-            } else {
-              generated_maze[t_row][t_col + 1] = gid_default;
-              generated_maze[t_row][t_col + 2] = gid_default;
-              t_col += 2;
-            }
-          } else if (start_col == col && start_row != row) {
-            if (start_row > row) {
-              generated_maze[t_row - 1][t_col] = gid_default;
-              generated_maze[t_row - 2][t_col] = gid_default;
-              t_row -= 2;
-            } else {
-              generated_maze[t_row + 1][t_col] = gid_default;
-              generated_maze[t_row + 2][t_col] = gid_default;
-              t_row += 2;
-            }
-          }
-
-          push(start_row, start_col);
-          push(row, col);
-          visited[row][col] = 1;
-          k = 1;
-
-        } else {
-          counter = n_matrix_[0][2] + n_matrix_[1][2]
-              + n_matrix_[2][2] + n_matrix_[3][2];
-        }
-      }
-    }
+  /// Open the exit
+  generated_maze.set(exitRow(), exitCol());
+
+  /// :) Returning perfect generated maze
+  return generated_maze;
+}
 
-    if (counter == 4) {
+void Generator::carve(matrix &maze, int first_row, int first_col, int rows, int cols,
+                      int start_row, int start_col) {
+  /// The visited matrix only needs to cover the cells, not the walls in
+  /// between them
+  const size_t cells = size_t(rows) * size_t(cols);
+  if (stack_.size() < cells) stack_.resize(cells);
+  visited_.reshape(rows, cols);
+  region_cols_ = cols;
+
+  /// Tile of the top left cell of the rectangle
+  const int tile_row = 2 * first_row + 1;
+  const int tile_col = 2 * first_col + 1;
+
+  int row = start_row;
+  int col = start_col;
+  maze.set(tile_row + 2 * row, tile_col + 2 * col);
+  visited_.set(row, col);
+
+  stack_index_ = 0;
+  push(uint32_t(row) * cols + col);
+
+  int candidates[4];
+
+  /// A backtrack starts every time the carver runs into a dead end
+  uint64_t backtracks = 0;
+  bool advanced = true;
+
+  while (stack_index_ != 0) {
+    /// Collect the neighbours that haven't been carved yet
+    int count = 0;
+    if (row > 0 && !visited_.get(row - 1, col)) candidates[count++] = 0;
+    if (col < cols - 1 && !visited_.get(row, col + 1)) candidates[count++] = 1;
+    if (row < rows - 1 && !visited_.get(row + 1, col)) candidates[count++] = 2;
+    if (col > 0 && !visited_.get(row, col - 1)) candidates[count++] = 3;
+
+    /// Dead end, backtrack
+    if (count == 0) {
+      backtracks += advanced;
+      advanced = false;
       pop(&row, &col);
-      if (start_row == row && start_col != col) {
-        if (start_col > col)t_col -= 2;
-        else t_col += 2;
-      } else if (start_col == col && start_row != row) {
-        if (start_row > row) t_row -= 2;
-        else t_row += 2;
-      }
-      push(row, col);
+      continue;
     }
 
-    n_matrix_[0][2] = 0;
-    n_matrix_[1][2] = 0;
-    n_matrix_[2][2] = 0;
-    n_matrix_[3][2] = 0;
+    /// Knock down the wall between both cells and move into the neighbour,
+    /// a single bounded draw picks among the open neighbours
+    const int choice = count == 1 ? 0 : int(random_.bounded(uint32_t(count)));
+    const int *direction = DIRECTIONS[candidates[choice]];
+    maze.set(tile_row + 2 * row + direction[0], tile_col + 2 * col + direction[1]);
+    row += direction[0];
+    col += direction[1];
+    maze.set(tile_row + 2 * row, tile_col + 2 * col);
+    visited_.set(row, col);
+    push(uint32_t(row) * cols + col);
+    advanced = true;
   }
 
-  /// Update the last index to gid_default
-  generated_maze[dimensions_ - 2][dimensions_ - 2] = gid_default;
-
-  /// Clean up
-  delete[] visited;
-  delete[] stack_;
-
-  /// :) Returning perfect generated maze
-  return generated_maze;
+  counters_.cells += cells;
+  counters_.backtracks += backtracks;
 }
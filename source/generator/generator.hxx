@@ -7,21 +7,106 @@
 #define __GENERATOR_HXX__
 
 #include <iostream>
-#include <random>
+#include <cstdint>
+#include <functional>
+#include <vector>
 
 #include "../globals.hxx"
-
-using matrix = int**;
+#include "../random/random.hxx"
 
 class IGenerator {
+ public:
+  /**
+   * Receives the rows of a maze from top to bottom, one bit per tile
+   */
+  using RowCallback = std::function<void(int /* row */, const BitMatrix::word* /* bits */)>;
+
+  /**
+   * Destructor
+   */
+  virtual ~IGenerator() = default;
+
+  /**
+   * Changes the width and height of the mazes produced by this generator.
+   * Cells sit on the odd rows and columns, the even ones are the walls in
+   * between them and the border.
+   */
+  virtual void resize(int /* width */, int /* height */);
+
+  /**
+   * Seeds the generator for the next maze. The same seed and stream always
+   * produce the same maze.
+   *
+   * @param seed   Seed of the batch
+   * @param stream Index of the maze in the batch
+   */
+  virtual void seed(uint64_t /* seed */, uint64_t /* stream */);
+
+  /**
+   * Draws a 64 bit seed from std::random_device, for mazes that don't need
+   * to be reproduced
+   */
+  static uint64_t entropySeed();
+
+  /**
+   * Interface method for generating a maze. Set bits in the returned matrix
+   * are passages, cleared bits are walls.
+   */
+   virtual matrix generateMaze(int /* s_row */, int /* s_col */)=0;
+
+  /**
+   * Generates a maze and hands it over row by row. By default the whole maze
+   * is generated first, streaming generators override this to only keep a
+   * few rows in memory.
+   */
+  virtual void generateRows(int /* s_row */, int /* s_col */, const RowCallback& /* callback */);
+
+  /**
+   * Whether generateRows() streams the maze instead of generating it whole
+   */
+  virtual bool streaming() const { return false; }
+
+  /**
+   * Work done by the last maze, kept as plain counters that are only summed
+   * up once per carve so they cost next to nothing
+   */
+  struct Counters {
+    /// Cells carved and dead ends the carver had to back out of
+    uint64_t cells = 0, backtracks = 0;
+
+    /// Seconds spent allocating the maze and the scratch memory
+    double allocate = 0;
+  };
+
+  const Counters &counters() const { return counters_; }
+
   /**
-   * Interface method for generating a maze
+   * Tile of the exit. It sits in the last cell, with an even width or height
+   * the row or column between that cell and the border stays a wall.
    */
-   virtual matrix generateMaze(int /* s_row */, int /* s_col */, const int gid_default)=0;
+  int exitRow() const { return 2 * cell_rows_ - 1; }
+  int exitCol() const { return 2 * cell_cols_ - 1; }
+
+ protected:
+  /// Counters of the last maze
+  Counters counters_;
+
+  /// Random number generator, seeded from entropySeed() until seed() is called
+  Random random_;
+
+  /// Seed and stream of the next maze
+  uint64_t seed_ = 0, stream_ = 0;
+
+  /// The maze dimensions and the amount of cells along each side
+  int width_ = 0, height_ = 0, cell_rows_ = 0, cell_cols_ = 0;
 };
 
-class Generator : IGenerator{
+class Generator : public IGenerator{
  public:
+  /// Most cells a single carve can cover, the stack keeps them as 32 bit
+  /// indices
+  static constexpr uint64_t MAX_CELLS = uint64_t(1) << 32;
+
   /**
    * Constructor
    */
@@ -33,52 +118,57 @@ class Generator : IGenerator{
   ~Generator();
 
   /**
-   * Generates the maze using.
-   */
-  int** generateMaze(int /* s_row */, int /* s_col */, const int gid_default) override;
- private:
-  /**
-   * Initializes and empty matrix and just initializes it all with 0
+   * Changes the dimensions of the mazes produced by this generator. The
+   * scratch memory is sized on the first maze and only ever grows, so a
+   * single generator can be reused for a whole batch without going back to
+   * the heap.
    */
-  int** initializeMatrix();
+  void resize(int /* dimensions */);
+  using IGenerator::resize;
 
   /**
-   * Initializes the neighbor matrix
+   * Generates the maze using.
    */
-  void initializeNMatrix();
+  matrix generateMaze(int /* s_row */, int /* s_col */) override;
 
   /**
-   * Initialize Stack
+   * Carves a perfect maze into a rectangle of cells, leaving the walls around
+   * the rectangle untouched. Only the tiles inside the rectangle are written.
+   * The rectangle can't have more than MAX_CELLS cells.
+   *
+   * @param maze      The maze to carve into
+   * @param first_row Cell row of the top left cell of the rectangle
+   * @param first_col Cell column of the top left cell of the rectangle
+   * @param rows      Amount of cell rows in the rectangle
+   * @param cols      Amount of cell columns in the rectangle
+   * @param start_row Cell row to start carving from, relative to the rectangle
+   * @param start_col Cell column to start carving from, relative to the rectangle
    */
-  void initializeStack();
-
+  void carve(matrix& /* maze */, int /* first_row */, int /* first_col */, int /* rows */,
+             int /* cols */, int /* start_row */, int /* start_col */);
+ private:
   /**
    * Push of the stack
    */
-  void push(int /* row */, int /* col */);
+  void push(uint32_t /* cell */);
 
   /**
    * Pops of the stack
    */
   void pop(int* /* row */, int* /* col */);
 
-  /// Used to obtain a seed for the random number engine
-  std::random_device rd_;
+  /// The stack of cell indices (row * region_cols_ + col). Holds at most one
+  /// entry per cell since a cell is only pushed the first time it is visited.
+  std::vector<uint32_t> stack_;
 
-  ///Standard mersenne_twister_engine seeded with rd_()
-  std::mt19937 gen_;
+  /// Width in cells of the rectangle being carved
+  int region_cols_ = 0;
 
-  /// The stack
-  matrix stack_;
-
-  /// The neighboring matrix
-  matrix n_matrix_;
+  /// Cells already visited by the carver, one bit per cell
+  BitMatrix visited_;
 
   /// the current stack index
-  int stack_index_ = 0;
-
-  /// The maze dimensions
-  int matrix_, dimensions_ = 0;
+  size_t stack_index_ = 0;
 };
 
 #endif /// __GENERATOR_HXX__
@@ -0,0 +1,106 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE for details)
+
+#include "region.hxx"
+#include <algorithm>
+#include <numeric>
+
+#include "../stats/stats.hxx"
+
+constexpr int RegionGenerator::REGION_CELLS;
+
+RegionGenerator::RegionGenerator(int width, int height, WorkerPool &pool, int worker)
+    : pool_(pool), worker_(worker), carvers_(size_t(pool.size())) {
+  seed(entropySeed(), 0);
+  resize(width, height);
+}
+
+matrix RegionGenerator::generateMaze(int, int) {
+  counters_ = Counters();
+  const Stopwatch allocate;
+  matrix generated_maze(height_, width_);
+  counters_.allocate = allocate.seconds();
+  if (cell_rows_ == 0) return generated_maze;
+
+  /// The carvers keep counting across mazes, only what they add is ours
+  for (const auto &carver : carvers_) {
+    if (carver == nullptr) continue;
+    counters_.cells -= carver->counters().cells;
+    counters_.backtracks -= carver->counters().backtracks;
+  }
+
+  const int region_rows = (cell_rows_ + REGION_CELLS - 1) / REGION_CELLS;
+  const int region_cols = (cell_cols_ + REGION_CELLS - 1) / REGION_CELLS;
+  const size_t regions = size_t(region_rows) * size_t(region_cols);
+
+  /// Regions get their own stream of a seed derived from the maze's stream
+  const uint64_t region_seed = seed_ ^ Random::mix(stream_ + 1);
+
+  /// Carve every region on its own. Regions start on a multiple of 32 cells,
+  /// i.e. tile 64k + 1, and end on the wall tile 64k', so they never share a
+  /// word and need no synchronisation.
+  pool_.parallelFor(regions, [&](size_t index, int worker) {
+    auto &carver = carvers_[worker];
+    if (carver == nullptr) carver.reset(new Generator(0));
+
+    const int first_row = int(index / region_cols) * REGION_CELLS;
+    const int first_col = int(index % region_cols) * REGION_CELLS;
+    const int rows = std::min(REGION_CELLS, cell_rows_ - first_row);
+    const int cols = std::min(REGION_CELLS, cell_cols_ - first_col);
+
+    carver->seed(region_seed, index);
+    carver->carve(generated_maze, first_row, first_col, rows, cols, 0, 0);
+  }, worker_);
+
+  for (const auto &carver : carvers_) {
+    if (carver == nullptr) continue;
+    counters_.cells += carver->counters().cells;
+    counters_.backtracks += carver->counters().backtracks;
+  }
+
+  /// Random spanning tree over the regions with Kruskal's algorithm. Edges
+  /// are numbered 2 * region (to the right) and 2 * region + 1 (down).
+  Random random(region_seed, regions);
+  std::vector<size_t> edges;
+  for (size_t region = 0; region < regions; region++) {
+    if (int(region % region_cols) + 1 < region_cols) edges.push_back(2 * region);
+    if (int(region / region_cols) + 1 < region_rows) edges.push_back(2 * region + 1);
+  }
+  for (size_t i = edges.size(); i > 1; i--)
+    std::swap(edges[i - 1], edges[random.bounded(uint32_t(i))]);
+
+  std::vector<size_t> parent(regions);
+  std::iota(parent.begin(), parent.end(), size_t(0));
+  auto find = [&parent](size_t region) {
+    while (parent[region] != region) region = parent[region] = parent[parent[region]];
+    return region;
+  };
+
+  for (const auto edge : edges) {
+    const size_t region = edge / 2;
+    const bool down = (edge & 1) != 0;
+    const size_t other = down ? region + region_cols : region + 1;
+
+    const size_t a = find(region), b = find(other);
+    if (a == b) continue;
+    parent[b] = a;
+
+    /// Open a random passage through the wall shared by both regions
+    const int first_row = int(region / region_cols) * REGION_CELLS;
+    const int first_col = int(region % region_cols) * REGION_CELLS;
+    if (down) {
+      const int cols = std::min(REGION_CELLS, cell_cols_ - first_col);
+      const int col = first_col + int(random.bounded(uint32_t(cols)));
+      generated_maze.set(2 * (first_row + REGION_CELLS), 2 * col + 1);
+    } else {
+      const int rows = std::min(REGION_CELLS, cell_rows_ - first_row);
+      const int row = first_row + int(random.bounded(uint32_t(rows)));
+      generated_maze.set(2 * row + 1, 2 * (first_col + REGION_CELLS));
+    }
+  }
+
+  /// Open the exit
+  generated_maze.set(exitRow(), exitCol());
+
+  return generated_maze;
+}
@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __REGION_HXX__
+#define __REGION_HXX__
+
+#include <memory>
+
+#include "generator.hxx"
+#include "../pool/pool.hxx"
+
+/**
+ * Generates a single large maze on several cores. The maze is split into
+ * rectangular regions, every region gets its own perfect maze carved in
+ * parallel, then exactly one passage is opened along every edge of a random
+ * spanning tree over the regions, which keeps the whole maze perfect.
+ */
+class RegionGenerator : public IGenerator {
+ public:
+  /// Cells along each side of a region. Must be a multiple of 32 so that
+  /// neighbouring regions never write to the same 64 bit word of a row.
+  static constexpr int REGION_CELLS = 512;
+
+  /**
+   * Constructor
+   *
+   * @param pool   Pool the regions are carved on
+   * @param worker Index of the worker calling generateMaze()
+   */
+  RegionGenerator(int /* width */, int /* height */, WorkerPool& /* pool */, int /* worker */);
+
+  /**
+   * Generates the maze. The start cell is ignored, every cell of a perfect
+   * maze is reachable from it anyway. Every region derives its own stream
+   * from the maze's, so the maze doesn't depend on which worker carves which
+   * region.
+   */
+  matrix generateMaze(int /* s_row */, int /* s_col */) override;
+
+ private:
+  /// Pool and the worker the generator belongs to
+  WorkerPool &pool_;
+  int worker_;
+
+  /// One backtracker per pool worker, created on first use
+  std::vector<std::unique_ptr<Generator>> carvers_;
+};
+
+#endif /// __REGION_HXX__
@@ -6,9 +6,11 @@
 #ifndef __GLOBALS_HXX__
 #define __GLOBALS_HXX__
 
+#include "matrix/matrix.hxx"
+
 /**
- * Typedef
+ * Typedef. A maze is stored as one bit per tile, set bits are carved passages
  */
-using matrix = int**;
+using matrix = BitMatrix;
 
 #endif /// __GLOBALS_HXX__
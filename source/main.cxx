@@ -1,38 +1,130 @@
 /// Copyright (c) 2017 Mozart Louis
 /// This code is licensed under MIT license (see LICENSE.txt for details)
 
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
 #include "cmd/cmd.hxx"
 #include "mapper/mapper.hxx"
+#include "server/server.hxx"
 
-void configure(cli::Parser &parser) {
-  parser.set_required<std::string>("f", "file", "JSON Config File");
-  parser.set_required<std::string>("o", "output", "Output Directory");
+void configure(cli::Parser &parser, bool serving) {
+  /// A server gets its config and output directory with every job, the
+  /// ones given here are only defaults
+  if (serving) {
+    parser.set_optional<std::string>("f", "file", "", "JSON Config File every job starts from");
+    parser.set_optional<std::string>("o", "output", ".", "Default Output Directory");
+  } else {
+    parser.set_required<std::string>("f", "file", "JSON Config File");
+    parser.set_required<std::string>("o", "output", "Output Directory");
+  }
+  parser.set_optional<int>("j", "jobs", WorkerPool::defaultWorkers(), "Number of worker threads");
+  parser.set_optional<std::string>("e", "encoding", "", "Layer encoding, csv or base64 (overrides tmx_encoding)");
+  parser.set_optional<std::string>("c", "compression", "",
+                                   "Layer compression, none, zlib, gzip or zstd (overrides tmx_compression)");
+  parser.set_optional<std::string>("s", "seed", "", "Seed making the generated mazes reproducible (overrides tmx_seed)");
+  parser.set_optional<bool>("S", "serve", false, "Run the newline delimited JSON jobs read from stdin");
+  parser.set_optional<std::string>("u", "socket", "", "Run the jobs of the clients of a unix domain socket");
+  parser.set_optional<int>("m", "cache", 64, "MB of generated mazes kept for repeated jobs when serving");
 }
 
 int main(int argc, char **argv) {
-  std::cout << std::endl
-            << "###### TMX Maze Generator - A perfect maze generation tool for Tiled"
-            << std::endl;
-  std::cout << "###### Copyright (c) 2017 Mozart Louis" << std::endl;
+  /// --stats takes an optional value the parser can't express, so it is
+  /// picked out before the parser sees the arguments
+  bool stats = false, stats_json = false;
+  int args = 1;
+  for (auto i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--stats") == 0 || std::strcmp(argv[i], "--stats=text") == 0) {
+      stats = true;
+    } else if (std::strcmp(argv[i], "--stats=json") == 0) {
+      stats = stats_json = true;
+    } else if (std::strncmp(argv[i], "--stats=", 8) == 0) {
+      std::cout << std::endl << "Unknown stats format \"" << argv[i] + 8 << "\", use text or json :(" << std::endl;
+      return 1;
+    } else {
+      argv[args++] = argv[i];
+    }
+  }
+  argc = args;
+
+  /// Servers answer on stdout and --stats=json reports there, so everything
+  /// else goes to stderr
+  bool serving = false;
+  for (auto i = 1; i < argc; i++)
+    for (const char *option : {"-S", "--serve", "-u", "--socket"})
+      serving = serving || std::strcmp(argv[i], option) == 0;
+  std::ostream &console = serving || stats_json ? std::cerr : std::cout;
+
+  console << std::endl
+          << "###### TMX Maze Generator - A perfect maze generation tool for Tiled"
+          << std::endl;
+  console << "###### Copyright (c) 2017 Mozart Louis" << std::endl;
 
   /// Create command line parser to handle all the command things
   cli::Parser parser(argc, argv);
-  configure(parser);
+  configure(parser, serving);
 
   /// Check to see if there are any errors with the user input
   parser.run_and_exit_if_error();
 
   /// Initialize mapper and execute
   const std::string file = parser.get<std::string>("f");
-  std::cout << "###### Reading \"" << file << "\"..." << std::endl;
-  auto mapper = new Mapper(file.c_str());
+  Mapper *mapper;
+  if (file.empty()) {
+    mapper = new Mapper(nlohmann::json::object());
+  } else {
+    console << "###### Reading \"" << file << "\"..." << std::endl;
+    mapper = new Mapper(file.c_str(), console);
+  }
+  mapper->setLog(console);
+
+  /// Command line options take precedence over the config
+  const std::string encoding = parser.get<std::string>("e");
+  const std::string compression = parser.get<std::string>("c");
+  if (!encoding.empty()) mapper->set(TMX_ENCODING, encoding);
+  if (!compression.empty()) mapper->set(TMX_COMPRESSION, compression);
+
+  const std::string seed = parser.get<std::string>("s");
+  if (!seed.empty()) {
+    /// std::stoull skips leading spaces, wraps negative numbers around and
+    /// stops at the first character that isn't a digit, none of which is a seed
+    try {
+      size_t end = 0;
+      if (!std::isdigit(static_cast<unsigned char>(seed[0]))) throw std::invalid_argument(seed);
+      const uint64_t value = std::stoull(seed, &end);
+      if (end != seed.size()) throw std::invalid_argument(seed);
+      mapper->set(TMX_SEED, value);
+    } catch (const std::exception &) {
+      console << std::endl << "Seed \"" << seed << "\" is not a non-negative integer :(" << std::endl;
+      return 1;
+    }
+  }
+
+  /// Serve jobs until stdin ends or forever on a socket
+  if (serving) {
+    JobServer server(*mapper, parser.get<std::string>("o"), parser.get<int>("j"),
+                     size_t(std::max(0, parser.get<int>("m"))) << 20);
+
+    const std::string socket = parser.get<std::string>("u");
+    if (socket.empty()) {
+      console << "###### Serving jobs from stdin..." << std::endl;
+      server.serve(std::cin, std::cout);
+      return 0;
+    }
+
+    console << "###### Serving jobs on \"" << socket << "\"..." << std::endl;
+    server.listen(socket);
+    console << std::endl << "Socket \"" << socket << "\" can't be served :(" << std::endl;
+    return 1;
+  }
 
-  /// Loop until all threads are finished
-  std::cout << "###### Generating..." << std::endl;
-  const auto& threads = mapper->execute(parser.get<std::string>("o"));
-  while (!threads.empty()) {}
+  /// Blocks until all mazes are saved
+  console << "###### Generating..." << std::endl;
+  if (!mapper->execute(parser.get<std::string>("o"), parser.get<int>("j"))) return 1;
 
-  std::cout << "###### Done!" << std::endl;
+  console << "###### Done!" << std::endl;
+  if (stats) mapper->stats().report(std::cout, stats_json);
 
   /// Exit
   return 0;
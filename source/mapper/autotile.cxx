@@ -0,0 +1,162 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "autotile.hxx"
+#include <algorithm>
+
+namespace {
+/**
+ * Spreads the bits of a byte over the lowest bit of the bytes of a word, so
+ * a mask bit of 8 tiles can be put in place with a single shift
+ */
+struct Spread {
+  uint64_t bytes[256];
+
+  Spread() {
+    for (int value = 0; value < 256; value++) {
+      bytes[value] = 0;
+      for (int bit = 0; bit < 8; bit++)
+        if (value & (1 << bit)) bytes[value] |= uint64_t(1) << (8 * bit);
+    }
+  }
+};
+
+const Spread SPREAD;
+
+/// Reads a GID of a table
+bool readGID(const nlohmann::json &value, uint32_t &gid, std::string &error) {
+  if (!value.is_number_unsigned() || value.get<uint64_t>() > UINT32_MAX) {
+    error = value.dump() + " is not a GID";
+    return false;
+  }
+  gid = value.get<uint32_t>();
+  return true;
+}
+
+/// Word i of a row, rows outside of the map and words outside of the row
+/// are walls
+inline BitMatrix::word wordAt(const BitMatrix::word *row, int i, int words) {
+  return row != nullptr && i >= 0 && i < words ? row[i] : 0;
+}
+
+/// The row shifted so bit i holds the tile to the east or the west of tile i
+inline BitMatrix::word east(const BitMatrix::word *row, int i, int words) {
+  return (wordAt(row, i, words) >> 1) | (wordAt(row, i + 1, words) << (BitMatrix::WORD_BITS - 1));
+}
+
+inline BitMatrix::word west(const BitMatrix::word *row, int i, int words) {
+  return (wordAt(row, i, words) << 1) | (wordAt(row, i - 1, words) >> (BitMatrix::WORD_BITS - 1));
+}
+}
+
+AutoTiler::AutoTiler(uint32_t gid) : gid_(gid) {}
+
+bool AutoTiler::parse(const nlohmann::json &config, uint32_t gid_default, std::string &error) {
+  if (!config.is_object()) {
+    error = "the autotile config must be an object";
+    return false;
+  }
+
+  const int neighbours = config.value("neighbours", 4);
+  if (neighbours != 4 && neighbours != 8) {
+    error = "autotile neighbours must be 4 or 8";
+    return false;
+  }
+
+  if (!parseTable(config.value("walls", nlohmann::json::object()), table_, 0, error)
+      || !parseTable(config.value("passages", nlohmann::json::object()), table_ + 256, gid_default, error))
+    return false;
+
+  neighbours_ = neighbours;
+  gid_ = gid_default;
+  return true;
+}
+
+bool AutoTiler::parseTable(const nlohmann::json &config, uint32_t *table, uint32_t fallback,
+                           std::string &error) const {
+  if (config.is_array()) {
+    if (config.size() > 256) {
+      error = "autotile tables have at most 256 masks";
+      return false;
+    }
+    std::fill(table, table + 256, fallback);
+    for (size_t mask = 0; mask < config.size(); mask++)
+      if (!readGID(config[mask], table[mask], error)) return false;
+    return true;
+  }
+
+  if (!config.is_object()) {
+    error = "autotile tables must be an array or an object";
+    return false;
+  }
+
+  if (config.count("default") && !readGID(config.at("default"), fallback, error)) return false;
+  std::fill(table, table + 256, fallback);
+
+  for (auto entry = config.begin(); entry != config.end(); ++entry) {
+    if (entry.key() == "default") continue;
+
+    /// Masks are plain decimal numbers without leading zeros, so a key can't
+    /// be read as octal or hex or name the same mask as another key
+    const std::string &key = entry.key();
+    unsigned long mask = key.empty() || key.size() > 3 || (key.size() > 1 && key[0] == '0') ? 256 : 0;
+    for (const char digit : key) mask = digit >= '0' && digit <= '9' ? mask * 10 + unsigned(digit - '0') : 256;
+
+    if (mask > 255) {
+      error = "\"" + entry.key() + "\" is not an autotile mask";
+      return false;
+    }
+    if (!readGID(entry.value(), table[mask], error)) return false;
+  }
+  return true;
+}
+
+void AutoTiler::mapRow(const BitMatrix::word *above, const BitMatrix::word *row,
+                       const BitMatrix::word *below, int width, uint32_t *gids) const {
+  /// Plain mapping, passages use the GID and walls the empty tile
+  if (neighbours_ == 0) {
+    for (int col = 0; col < width; col++)
+      gids[col] = gid_ & (0u - uint32_t((row[col / BitMatrix::WORD_BITS] >> (col % BitMatrix::WORD_BITS)) & 1u));
+    return;
+  }
+
+  const int words = (width + BitMatrix::WORD_BITS - 1) / BitMatrix::WORD_BITS;
+  BitMatrix::word planes[8];
+
+  for (int i = 0; i < words; i++) {
+    /// Bit planes of the neighbours in mask order, a set bit is a passage
+    const BitMatrix::word tiles = row[i];
+    if (neighbours_ == 4) {
+      planes[0] = wordAt(above, i, words);
+      planes[1] = east(row, i, words);
+      planes[2] = wordAt(below, i, words);
+      planes[3] = west(row, i, words);
+    } else {
+      planes[0] = wordAt(above, i, words);
+      planes[1] = east(above, i, words);
+      planes[2] = east(row, i, words);
+      planes[3] = east(below, i, words);
+      planes[4] = wordAt(below, i, words);
+      planes[5] = west(below, i, words);
+      planes[6] = west(row, i, words);
+      planes[7] = west(above, i, words);
+    }
+
+    /// Keep the neighbours of the same kind as the tile
+    for (int k = 0; k < neighbours_; k++) planes[k] = ~(planes[k] ^ tiles);
+
+    /// Transpose the planes into one mask byte per tile, 8 tiles at a time
+    const int first = i * BitMatrix::WORD_BITS;
+    const int count = std::min(BitMatrix::WORD_BITS, width - first);
+    for (int bit = 0; bit < count; bit += 8) {
+      uint64_t masks = 0;
+      for (int k = 0; k < neighbours_; k++) masks |= SPREAD.bytes[(planes[k] >> bit) & 0xff] << k;
+      const uint64_t kinds = SPREAD.bytes[(tiles >> bit) & 0xff];
+
+      const int n = std::min(8, count - bit);
+      uint32_t *out = gids + first + bit;
+      for (int j = 0; j < n; j++)
+        out[j] = table_[((kinds >> (8 * j)) & 1) << 8 | ((masks >> (8 * j)) & 0xff)];
+    }
+  }
+}
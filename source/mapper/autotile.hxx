@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __AUTOTILE_HXX__
+#define __AUTOTILE_HXX__
+
+#include <cstdint>
+#include <string>
+
+#include "../globals.hxx"
+#include "../json/json.hxx"
+
+/**
+ * Maps the tiles of a maze to GIDs. Without a table passages get a single
+ * GID and walls stay empty. With a table every tile looks up its GID by the
+ * mask of its neighbours that are of the same kind, i.e. passages next to
+ * passages and walls next to walls, which is what blob and Wang style tile
+ * sets expect.
+ *
+ * Mask bits go clockwise from the top: N=1, E=2, S=4, W=8 with 4 neighbours
+ * and N=1, NE=2, E=4, SE=8, S=16, SW=32, W=64, NW=128 with 8. Anything
+ * outside of the map counts as a wall.
+ */
+class AutoTiler {
+ public:
+  /**
+   * Constructor, every passage gets the given GID
+   */
+  explicit AutoTiler(uint32_t gid = 0);
+
+  /**
+   * Loads an autotile table from the config. The table has the amount of
+   * "neighbours", 4 or 8, and a "walls" and a "passages" table. Each maps
+   * masks to GIDs, either as an array indexed by mask or as an object with
+   * the mask as key and an optional "default" for the masks not listed.
+   *
+   * @param config      The autotile config
+   * @param gid_default Default GID of the passages
+   * @param error       Receives what is wrong with the config
+   * @return false if the config is invalid
+   */
+  bool parse(const nlohmann::json & /* config */, uint32_t /* gid_default */, std::string & /* error */);
+
+  /**
+   * Maps a row of the maze to GIDs. The masks of 64 tiles are computed at
+   * once from shifted words of the row and its neighbours.
+   *
+   * @param above The row above, nullptr for the first row
+   * @param row   The row to map
+   * @param below The row below, nullptr for the last row
+   * @param width Amount of tiles in the row
+   * @param gids  Receives the GIDs
+   */
+  void mapRow(const BitMatrix::word * /* above */, const BitMatrix::word * /* row */,
+              const BitMatrix::word * /* below */, int /* width */, uint32_t * /* gids */) const;
+
+ private:
+  /**
+   * Fills one half of the table from its config
+   */
+  bool parseTable(const nlohmann::json & /* config */, uint32_t * /* table */, uint32_t /* fallback */,
+                  std::string & /* error */) const;
+
+  /// 0 without a table, 4 or 8 otherwise
+  int neighbours_ = 0;
+
+  /// GID of the passages without a table
+  uint32_t gid_ = 0;
+
+  /// GIDs of the walls followed by those of the passages, indexed by mask
+  uint32_t table_[512] = {};
+};
+
+#endif /// __AUTOTILE_HXX__
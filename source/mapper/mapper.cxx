@@ -2,11 +2,25 @@
 /// This code is licensed under MIT license (see LICENSE.txt for details)
 
 #include "mapper.hxx"
+#include <algorithm>
+#include <atomic>
 #include <fstream>
-#include <thread>
-#include <list>
+#include <memory>
+#include <cerrno>
+#include <cstdint>
+#include <sys/stat.h>
+
+#include "../analyzer/analyzer.hxx"
+#include "../encoder/layer.hxx"
+#include "../generator/eller.hxx"
+#include "../generator/region.hxx"
+
+constexpr int Mapper::MAX_SIDE;
+constexpr int Mapper::MAX_AMOUNT;
+
+Mapper::Mapper(const char *config, std::ostream &log) : log_(&log) {
+  const Stopwatch parse;
 
-Mapper::Mapper(const char *config) {
   /// open the json file
   std::ifstream file(config);
 
@@ -15,114 +29,528 @@ Mapper::Mapper(const char *config) {
     if (!file.bad() && file.is_open()) file >> j_;
     else throw std::exception();
   } catch (const std::exception &) {
-    std::cout << std::endl << "JSON Config \"" << config << "\" either does not exist, is malformed or corrupt :("
+    *log_ << std::endl << "JSON Config \"" << config << "\" either does not exist, is malformed or corrupt :("
               << std::endl;
   }
 
   /// Close file
   file.close();
+  stats_.setParse(parse.seconds());
 }
 
+Mapper::Mapper(const nlohmann::json &config) : j_(config) {}
+
 Mapper::~Mapper() = default;
 
-std::vector<int> &Mapper::execute(std::string output) {
-  /// Output
-  std::system(("mkdir " + output).c_str());
+void Mapper::set(const std::string &key, const nlohmann::json &value) { j_[key] = value; }
+
+void Mapper::load(const nlohmann::json &config) { j_ = config; }
+
+bool Mapper::execute(const std::string &output, int workers, std::vector<std::string> *documents) {
+  /// Check everything the workers read up front, a broken config is reported
+  /// here instead of taking down a worker
+  try {
+    for (const char *key : {TMX_NAME, TMX_LAYER, TMX_TILE_SET, TMX_TILE_SET_NAME})
+      if (!j_.count(key) || !j_.at(key).is_string()) throw std::runtime_error(std::string(key) + " must be a string");
+    for (const char *key : {TMX_DIMENSIONS, TMX_DIMENSIONS_INCREMENT, TMX_DIMENSIONS_REPEAT, TMX_AMOUNT,
+                            TMX_TILE_WIDTH, TMX_TILE_HEIGHT, TMX_GID_DEFAULT})
+      if (!j_.count(key) || !j_.at(key).is_number_integer())
+        throw std::runtime_error(std::string(key) + " must be an integer");
+
+    /// Optional keys only need the right type when they are there
+    for (const char *key : {TMX_ENCODING, TMX_COMPRESSION, TMX_ALGORITHM, TMX_SOLUTION_LAYER})
+      if (j_.count(key) && !j_.at(key).is_string()) throw std::runtime_error(std::string(key) + " must be a string");
+    for (const char *key : {TMX_HEIGHT, TMX_TILE_SET_WIDTH, TMX_TILE_SET_HEIGHT, TMX_MAX_ATTEMPTS, TMX_SOLUTION_GID})
+      if (j_.count(key) && !j_.at(key).is_number_integer())
+        throw std::runtime_error(std::string(key) + " must be an integer");
+    for (const char *key : {TMX_MIN_SOLUTION_RATIO, TMX_MAX_DEAD_END_RATIO})
+      if (j_.count(key) && !j_.at(key).is_number()) throw std::runtime_error(std::string(key) + " must be a number");
+    if (j_.count(TMX_SEED) && !j_.at(TMX_SEED).is_number_unsigned())
+      throw std::runtime_error(std::string(TMX_SEED) + " must be a non-negative integer");
+    if (j_.count(TMX_ANALYZE) && !j_.at(TMX_ANALYZE).is_boolean())
+      throw std::runtime_error(std::string(TMX_ANALYZE) + " must be true or false");
+
+    /// Widths change linearly along the batch, so the first and the last
+    /// maze are the extremes. A maze needs a cell and the border around it,
+    /// and the backtracker carves all of its cells in a single rectangle.
+    const bool backtracker = j_.value(TMX_ALGORITHM, std::string("backtracker")) == "backtracker";
+    const int amount = j_.at(TMX_AMOUNT);
+    if (amount < 0 || amount > MAX_AMOUNT)
+      throw std::runtime_error(std::string(TMX_AMOUNT) + " must be between 0 and " + std::to_string(MAX_AMOUNT));
+    for (const int index : {0, amount - 1}) {
+      if (index < 0) continue;
+      const int64_t width = mazeWidth(index);
+      const int64_t height = mazeHeight(width);
+      if (width < 3 || width > MAX_SIDE || height < 3 || height > MAX_SIDE)
+        throw std::runtime_error("maze " + std::to_string(index + 1) + " is " + std::to_string(width) + "x"
+                                 + std::to_string(height) + ", sides must be between 3 and "
+                                 + std::to_string(MAX_SIDE) + " tiles");
+      if (backtracker && uint64_t((width - 1) / 2) * uint64_t((height - 1) / 2) > Generator::MAX_CELLS)
+        throw std::runtime_error("maze " + std::to_string(index + 1) + " has more than "
+                                 + std::to_string(Generator::MAX_CELLS)
+                                 + " cells, use the eller or parallel algorithm");
+    }
+    generateTMXHeader(1, 1);
+  } catch (const std::exception &e) {
+    *log_ << std::endl << "Invalid config, " << e.what() << " :(" << std::endl;
+    return false;
+  }
+
+  /// Layer encoding, compression is only allowed on base64 data like in Tiled
+  const std::string compression = j_.value(TMX_COMPRESSION, std::string());
+  const std::string encoding = j_.value(TMX_ENCODING, std::string(compression.empty() ? "csv" : "base64"));
+  if (encoding != "csv" && encoding != "base64") {
+    *log_ << std::endl << "Unknown encoding \"" << encoding << "\", use csv or base64 :(" << std::endl;
+    return false;
+  }
+  base64_ = encoding == "base64";
+
+  if (!Compressor::parse(compression, compression_) || !Compressor::supported(compression_)
+      || (!base64_ && compression_ != Compression::NONE)) {
+    *log_ << std::endl << "Compression \"" << compression << "\" is unknown, not supported by this build "
+          << "or used without base64 encoding :(" << std::endl;
+    return false;
+  }
+
+  algorithm_ = j_.value(TMX_ALGORITHM, std::string("backtracker"));
+  if (algorithm_ != "backtracker" && algorithm_ != "eller" && algorithm_ != "parallel") {
+    *log_ << std::endl << "Unknown algorithm \"" << algorithm_ << "\", use backtracker, eller or parallel :("
+          << std::endl;
+    return false;
+  }
+
+  /// Analysis runs when a filter or the solution layer asks for it, or to
+  /// get the metrics into the stats
+  min_solution_ratio_ = j_.value(TMX_MIN_SOLUTION_RATIO, 0.0);
+  max_dead_end_ratio_ = j_.value(TMX_MAX_DEAD_END_RATIO, 1.0);
+  max_attempts_ = std::max(1, j_.value(TMX_MAX_ATTEMPTS, 10));
+  solution_layer_ = j_.value(TMX_SOLUTION_LAYER, std::string());
+  filter_ = j_.count(TMX_MIN_SOLUTION_RATIO) || j_.count(TMX_MAX_DEAD_END_RATIO);
+  analyze_ = filter_ || !solution_layer_.empty() || j_.value(TMX_ANALYZE, false);
+
+  /// Passages use the default GID unless an autotile table picks the tiles
+  const uint32_t gid = uint32_t(int(j_.at(TMX_GID_DEFAULT)));
+  tiles_ = AutoTiler(gid);
+  if (j_.count(TMX_AUTOTILE)) {
+    std::string error;
+    bool valid = false;
+    try {
+      valid = tiles_.parse(j_.at(TMX_AUTOTILE), gid, error);
+    } catch (const std::exception &e) {
+      error = e.what();
+    }
+
+    if (!valid) {
+      *log_ << std::endl << "Invalid " << TMX_AUTOTILE << ", " << error << " :(" << std::endl;
+      return false;
+    }
+  }
+
+  /// Output, mazes kept in memory don't need a directory
+  if (documents == nullptr && !makeDirectory(output)) {
+    *log_ << std::endl << "Output directory \"" << output << "\" can't be created :(" << std::endl;
+    return false;
+  }
 
   /// info needed from the json config file
   const std::string name = j_.at(TMX_NAME);
 
   const int amount = j_.at(TMX_AMOUNT);
   const int gid_default = j_.at(TMX_GID_DEFAULT);
-  const int dimensions_increment = j_.at(TMX_DIMENSIONS_INCREMENT);
-  const int dimensions_repeat = j_.at(TMX_DIMENSIONS_REPEAT);
-  int dimensions_repeat_copy = dimensions_repeat;
-  int dimensions = j_.at(TMX_DIMENSIONS);
-
-  /// running a loop to generate x amount of mazes
-  for (auto i = 1; i <= amount; i++) {
-    threads_.push_back(amount);
-    std::function<void()> func = [=, &dimensions_repeat_copy, &dimensions]() {
-      dimensions_repeat_copy--;
-
-      /// Create a generator instance
-      if (dimensions_repeat_copy < 0) {
-        dimensions_repeat_copy = dimensions_repeat - 1;
-        dimensions += dimensions_increment;
+  solution_tiles_ = AutoTiler(uint32_t(j_.value(TMX_SOLUTION_GID, gid_default)));
+
+  /// Every maze draws from its own random stream derived from the seed and
+  /// its number, so a batch is reproducible however it gets scheduled
+  const uint64_t seed = j_.count(TMX_SEED) ? j_.at(TMX_SEED).get<uint64_t>() : IGenerator::entropySeed();
+  seed_ = seed;
+  *log_ << "###### Seed " << seed << std::endl;
+
+  /// Work out the size of every maze up front
+  struct Job {
+    int width, height, id;
+  };
+  std::vector<Job> mazes;
+  for (auto i = 0; i < amount; i++) {
+    const int64_t width = mazeWidth(i);
+    mazes.push_back({int(width), int(mazeHeight(width)), i + 1});
+  }
+
+  /// Hand out the largest mazes first so they don't end up as the tail of
+  /// the batch
+  std::stable_sort(mazes.begin(), mazes.end(), [](const Job &a, const Job &b) {
+    return uint64_t(a.width) * uint64_t(a.height) > uint64_t(b.width) * uint64_t(b.height);
+  });
+
+  /// The pool and every worker's generator and writer outlive the batch, so
+  /// scratch memory is allocated once per worker instead of once per maze
+  /// and a mapper running many batches keeps its threads warm
+  if (pool_ == nullptr || workers != pool_workers_) {
+    workers_.clear();
+    pool_.reset(new WorkerPool(workers));
+    pool_workers_ = workers;
+    for (auto i = 0; i < pool_->size(); i++) workers_.emplace_back(new Worker());
+  }
+  stats_.begin(pool_->size());
+
+  if (documents != nullptr) documents->assign(size_t(std::max(0, amount)), std::string());
+
+  /// Cleared by any maze that couldn't be written
+  std::atomic<bool> saved(true);
+
+  for (const auto &maze : mazes) {
+    pool_->submit([=, &saved](int worker) {
+      const Stopwatch latency;
+      auto &state = *workers_[worker];
+      MazeStats stats;
+
+      /// A maze that can't be produced, say for lack of memory, fails the
+      /// batch but not the process
+      try {
+        if (state.generator == nullptr || state.algorithm != algorithm_) {
+          state.generator = createGenerator(maze.width, maze.height, worker);
+          state.algorithm = algorithm_;
+        } else {
+          state.generator->resize(maze.width, maze.height);
+        }
+        state.generator->seed(seed, uint64_t(maze.id));
+
+        /// Save the tmx file, or keep it in memory
+        std::string *document = documents != nullptr ? &(*documents)[size_t(maze.id - 1)] : nullptr;
+        if (!save(*state.generator, name, maze.width, maze.height, maze.id, output, worker, document, stats))
+          saved = false;
+      } catch (const std::exception &e) {
+        saved = false;
+        state.generator.reset();
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        *log_ << std::endl << "Maze " << maze.id << " failed, " << e.what() << " :(" << std::endl;
       }
 
-      auto generator = new Generator(dimensions);
-      auto maze = generator->generateMaze(1, 1, gid_default);
+      stats.id = maze.id;
+      stats.width = maze.width;
+      stats.height = maze.height;
+      stats.worker = worker;
+      stats.latency = latency.seconds();
+      stats_.add(stats);
+    });
+  }
 
-      /// Save the tmx file
-      save(maze, name, dimensions, i, output);
+  pool_->wait();
+  stats_.end();
+  return saved;
+}
 
-      /// Clean up
-      delete[] maze;
+bool Mapper::store(const std::string &output, const std::string &name, const std::vector<std::string> &documents) {
+  if (!makeDirectory(output)) return false;
 
-      /// Pop the amount id out of the vector
-      threads_.pop_back();
-    };
+  TMXWriter writer;
+  for (size_t i = 0; i < documents.size(); i++) {
+    if (!writer.open(path(output, name, int(i + 1)))) return false;
+    writer.write(documents[i]);
+    if (!writer.close()) return false;
+  }
+  return true;
+}
+
+size_t Mapper::estimate() const {
+  try {
+    const int amount = j_.at(TMX_AMOUNT).get<int>();
+    if (amount > MAX_AMOUNT) return SIZE_MAX;
+    const std::string compression = j_.value(TMX_COMPRESSION, std::string());
+    const bool base64 = j_.value(TMX_ENCODING, std::string(compression.empty() ? "csv" : "base64")) == "base64";
+
+    /// A csv tile is the default GID and a comma, base64 spends 4 characters
+    /// on every 3 bytes of a 4 byte GID
+    const uint64_t gid_characters = std::to_string(j_.at(TMX_GID_DEFAULT).get<int64_t>()).size();
+    const uint64_t layers = j_.value(TMX_SOLUTION_LAYER, std::string()).empty() ? 1 : 2;
 
-    std::thread t1([=]() { if (func != nullptr) func(); });
-    t1.join();
+    uint64_t bytes = 0;
+    for (auto i = 0; i < amount; i++) {
+      const uint64_t width = uint64_t(std::max<int64_t>(0, mazeWidth(i)));
+      const uint64_t height = uint64_t(std::max<int64_t>(0, mazeHeight(int64_t(width))));
+      const uint64_t tiles = width * height;
+      bytes += layers * (base64 ? (tiles * 16 + 2) / 3 : tiles * (gid_characters + 1) + height);
+    }
+    return size_t(std::min<uint64_t>(bytes, SIZE_MAX));
+  } catch (const std::exception &) {
+    return SIZE_MAX;
   }
+}
+
+int64_t Mapper::mazeWidth(int index) const {
+  const int repeat = j_.at(TMX_DIMENSIONS_REPEAT);
+  const int64_t step = repeat > 0 ? index / repeat : index + 1;
+  return int64_t(j_.at(TMX_DIMENSIONS).get<int>()) + step * j_.at(TMX_DIMENSIONS_INCREMENT).get<int>();
+}
+
+int64_t Mapper::mazeHeight(int64_t width) const {
+  return j_.count(TMX_HEIGHT) ? int64_t(j_.at(TMX_HEIGHT).get<int>()) : width;
+}
 
-  return threads_;
+std::string Mapper::path(const std::string &output, const std::string &name, int id) {
+  return output + "/" + name + "_" + std::to_string(id) + ".tmx";
 }
 
-void Mapper::save(matrix &maze, const std::string &name, const int &dimensions,
-                  const int &amount, const std::string &dir) {
-  std::ofstream output;
-  std::stringstream ss;
-  std::string data;
+bool Mapper::makeDirectory(const std::string &path) {
+  struct stat info{};
+  if (mkdir(path.c_str(), 0755) == 0) return true;
+  return errno == EEXIST && stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
 
-  /// Loop through the generated maze to create the string data in CSV format
-  for (int ii = 0; ii < dimensions; ii++)
-    for (int jj = 0; jj < dimensions; jj++)
-      ss << std::to_string(maze[ii][jj]) << ",";
+std::unique_ptr<IGenerator> Mapper::createGenerator(int width, int height, int worker) const {
+  if (algorithm_ == "eller") return std::unique_ptr<IGenerator>(new EllerGenerator(width, height));
+  if (algorithm_ == "parallel")
+    return std::unique_ptr<IGenerator>(new RegionGenerator(width, height, *pool_, worker));
 
-  /// Stream into our data string. We need to pop the last char in the string
-  /// because it will always be a leftover comma.
-  ss >> data;
-  data.pop_back();
+  std::unique_ptr<IGenerator> generator(new Generator(width));
+  generator->resize(width, height);
+  return generator;
+}
 
-  /// creating our final tmx map data and saving to the system
-  const std::string tmx = generateTMXHeader(dimensions) + data + generateTMXTail();
+bool Mapper::save(IGenerator &generator, const std::string &name, const int &width,
+                  const int &height, const int &amount, const std::string &dir, int worker,
+                  std::string *document, MazeStats &stats) const {
+  const Stopwatch total;
+  auto &state = *workers_[worker];
+  auto &writer = state.writer;
+  auto &gids = state.gids;
 
   /// Create the files
-  output.open(dir + "/" + name + "_" + std::to_string(amount) + ".tmx");
-  if (output.is_open() && !output.bad()) output << tmx;
-  output.close();
+  if (document != nullptr) {
+    writer.capture(*document);
+  } else if (!writer.open(path(dir, name, amount))) {
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    *log_ << std::endl << "Couldn't create " << path(dir, name, amount) << " :(" << std::endl;
+    return false;
+  }
+  writer.write(generateTMXHeader(width, height));
+  writer.write(generateLayerHeader(j_.at(TMX_LAYER), width, height));
+  writer.write("\n", 1);
+
+  /// Time spent generating and analyzing, rows handed over while streaming
+  /// don't count
+  double generate = 0, analyze = 0;
+
+  if (analyze_) {
+    /// Regenerate from a new stream until the maze passes the filters, the
+    /// first attempt uses the same stream as without analysis
+    matrix maze;
+    for (stats.attempts = 1;; stats.attempts++) {
+      if (stats.attempts > 1) generator.seed(seed_, uint64_t(amount) | uint64_t(stats.attempts - 1) << 32);
+
+      const Stopwatch carve;
+      maze = generator.generateMaze(1, 1);
+      generate += carve.seconds();
+
+      const auto &counters = generator.counters();
+      stats.cells += counters.cells;
+      stats.backtracks += counters.backtracks;
+      stats.allocate += counters.allocate;
+
+      const Stopwatch measure;
+      const Analysis &analysis =
+          state.analyzer.analyze(maze, 1, 1, generator.exitRow(), generator.exitCol(),
+                                 !solution_layer_.empty());
+      analyze += measure.seconds();
+
+      stats.perfect = analysis.perfect;
+      stats.solution = analysis.solution;
+      stats.dead_ends = analysis.dead_ends;
+      stats.junctions = analysis.junctions;
+      stats.branching = analysis.branching;
+      stats.longest_corridor = analysis.longest_corridor;
+
+      /// Every generator carves perfect mazes, another attempt wouldn't fix
+      /// one that isn't
+      if (!analysis.perfect) {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        *log_ << std::endl << "Maze " << amount << " is not a perfect maze, the " << algorithm_
+              << " generator has a bug :(" << std::endl;
+        break;
+      }
+
+      if (accept(analysis)) break;
+      if (stats.attempts >= max_attempts_) {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        *log_ << std::endl << "Maze " << amount << " did not pass the filters in " << stats.attempts
+              << " attempts, keeping the last one :(" << std::endl;
+        break;
+      }
+    }
+
+    writeLayer(maze, tiles_, worker);
+
+    /// The solution goes on a layer of its own on top of the maze
+    if (!solution_layer_.empty()) {
+      writer.write(generateLayerTail());
+      writer.write(generateLayerHeader(solution_layer_, width, height));
+      writer.write("\n", 1);
+      writeLayer(state.analyzer.solution(), solution_tiles_, worker);
+    }
+  } else if (compression_ != Compression::NONE && !generator.streaming()) {
+    /// The whole maze is in memory anyway, compress it on every free worker
+    const Stopwatch carve;
+    const matrix maze = generator.generateMaze(1, 1);
+    generate = carve.seconds();
+    writeCompressed(maze, tiles_, worker);
+  } else {
+    /// Stream the maze row by row, streaming generators never hold more
+    /// than a couple of rows. A row is mapped once the one below it arrived,
+    /// so the last three rows are kept around.
+    LayerEncoder encoder(writer, base64_, compression_, state.raw);
+    auto &window = state.window;
+    window.reshape(3, width);
+    gids.resize(size_t(width));
+
+    auto emit = [&](int row) {
+      const BitMatrix::word *above = row > 0 ? window.row((row - 1) % 3) : nullptr;
+      const BitMatrix::word *below = row + 1 < height ? window.row((row + 1) % 3) : nullptr;
+      tiles_.mapRow(above, window.row(row % 3), below, width, gids.data());
+      encoder.writeRow(gids.data(), gids.size(), row == height - 1);
+    };
+
+    double rows = 0;
+    const Stopwatch carve;
+    generator.generateRows(1, 1, [&](int row, const BitMatrix::word *bits) {
+      const Stopwatch serialize;
+      std::copy(bits, bits + window.stride(), window.row(row % 3));
+      if (row > 0) emit(row - 1);
+      rows += serialize.seconds();
+    });
+    generate = carve.seconds() - rows;
+    if (height > 0) emit(height - 1);
+  }
+
+  writer.write(generateLayerTail());
+  writer.write(generateTMXTail());
+  const bool written = writer.close();
+  if (!written) {
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    *log_ << std::endl << "Couldn't write " << path(dir, name, amount) << " :(" << std::endl;
+  }
+
+  if (!analyze_) {
+    const auto &counters = generator.counters();
+    stats.cells = counters.cells;
+    stats.backtracks = counters.backtracks;
+    stats.allocate = counters.allocate;
+  }
+
+  /// Whatever isn't generating, analyzing or writing is spent serializing
+  stats.bytes = writer.written();
+  stats.carve = std::max(0.0, generate - stats.allocate);
+  stats.analyze = analyze;
+  stats.write = writer.writeSeconds();
+  stats.serialize = std::max(0.0, total.seconds() - generate - analyze - stats.write);
+  return written;
 }
 
-std::string Mapper::generateTMXHeader(const int &dimensions) {
-  const std::string layer = j_[TMX_LAYER];
-  const std::string tile_set = j_[TMX_TILE_SET];
-  const std::string tile_set_name = j_[TMX_TILE_SET_NAME];
-  const std::string dimensions_str = std::to_string(dimensions);
-  const std::string tile_width_str = std::to_string(int(j_[TMX_TILE_WIDTH]));
-  const std::string tile_height_str = std::to_string(int(j_[TMX_TILE_HEIGHT]));
+bool Mapper::accept(const Analysis &analysis) const {
+  if (!filter_) return true;
+
+  const double tiles = double(std::max<uint64_t>(1, analysis.tiles));
+  return double(analysis.solution) / tiles >= min_solution_ratio_
+      && double(analysis.dead_ends) / tiles <= max_dead_end_ratio_;
+}
+
+void Mapper::writeLayer(const matrix &maze, const AutoTiler &tiles, int worker) const {
+  if (compression_ != Compression::NONE) {
+    writeCompressed(maze, tiles, worker);
+    return;
+  }
+
+  auto &state = *workers_[worker];
+  LayerEncoder encoder(state.writer, base64_, compression_, state.raw);
+  state.gids.resize(size_t(maze.cols()));
+  for (int row = 0; row < maze.rows(); row++) {
+    mapRow(maze, row, tiles, state.gids.data());
+    encoder.writeRow(state.gids.data(), state.gids.size(), row == maze.rows() - 1);
+  }
+}
+
+void Mapper::mapRow(const matrix &maze, int row, const AutoTiler &tiles, uint32_t *gids) const {
+  tiles.mapRow(row > 0 ? maze.row(row - 1) : nullptr, maze.row(row),
+               row + 1 < maze.rows() ? maze.row(row + 1) : nullptr, maze.cols(), gids);
+}
+
+void Mapper::writeCompressed(const matrix &maze, const AutoTiler &tiles, int worker) const {
+  const size_t width = size_t(maze.cols());
+  const int rows = int(std::max<size_t>(1, LayerEncoder::CHUNK_SIZE / (width * 4)));
+  const size_t count = (size_t(maze.rows()) + rows - 1) / rows;
+
+  /// Compress the chunks on every worker that is free, the compressed data
+  /// is small enough to be kept until all chunks are done
+  std::vector<Compressor::Chunk> chunks(count);
+  pool_->parallelFor(count, [&](size_t index, int w) {
+    auto &state = *workers_[w];
+    const int first = int(index) * rows;
+    const int last = std::min(first + rows, maze.rows());
+
+    state.gids.resize(width);
+    state.raw.resize(size_t(last - first) * width * 4);
+    for (int row = first; row < last; row++) {
+      mapRow(maze, row, tiles, state.gids.data());
+      LayerEncoder::storeLittleEndian(state.gids.data(), width, state.raw.data() + size_t(row - first) * width * 4);
+    }
+
+    Compressor::compress(compression_, state.raw.data(), state.raw.size(), index + 1 == count,
+                         chunks[index]);
+  }, worker);
+
+  /// Stitch the chunks into a single stream
+  Base64Stream stream(workers_[worker]->writer);
+  const std::string header = Compressor::header(compression_);
+  stream.write(reinterpret_cast<const uint8_t *>(header.data()), header.size());
+  for (auto &chunk : chunks) {
+    stream.write(reinterpret_cast<const uint8_t *>(chunk.data.data()), chunk.data.size());
+    std::string().swap(chunk.data);
+  }
+  const std::string trailer = Compressor::trailer(compression_, chunks);
+  stream.write(reinterpret_cast<const uint8_t *>(trailer.data()), trailer.size());
+  stream.finish();
+  workers_[worker]->writer.write("\n", 1);
+}
+
+std::string Mapper::generateTMXHeader(const int &width, const int &height) const {
+  const std::string tile_set = j_.at(TMX_TILE_SET);
+  const std::string tile_set_name = j_.at(TMX_TILE_SET_NAME);
+  const std::string width_str = std::to_string(width);
+  const std::string height_str = std::to_string(height);
+  const int tile_width = j_.at(TMX_TILE_WIDTH);
+  const int tile_height = j_.at(TMX_TILE_HEIGHT);
+  const std::string tile_width_str = std::to_string(tile_width);
+  const std::string tile_height_str = std::to_string(tile_height);
+
+  /// The tile set layout follows from the size of its image
+  const int image_width = j_.value(TMX_TILE_SET_WIDTH, 540);
+  const int image_height = j_.value(TMX_TILE_SET_HEIGHT, 756);
+  const int columns = tile_width > 0 ? image_width / tile_width : 0;
+  const int tile_count = tile_height > 0 ? columns * (image_height / tile_height) : 0;
 
   return "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
       "<map version=\"1.0\" tiledversion=\"1.0.2\" orientation=\"orthogonal\" "
-      "renderorder=\"right-down\" width=\"" + dimensions_str
+      "renderorder=\"right-down\" width=\"" + width_str
       + "\" height=\""
-      + dimensions_str + "\" "
+      + height_str + "\" "
       "tilewidth=\"" + tile_width_str
       + "\" tileheight=\"" + tile_height_str + "\" nextobjectid=\"1\">\n"
       " <tileset firstgid=\"1\" name=\"" + tile_set_name + "\" "
       " tilewidth=\"" + tile_width_str
-      + "\" tileheight=\"" + tile_height_str + "\" tilecount=\"35\" "
-      "columns=\"5\">\n"
-      "  <image source=\"" + tile_set + "\" width=\"540\" "
-      "height=\"756\"/>\n"
-      " </tileset>\n"
-      " <layer name=\"" + layer + "\" width=\"" + dimensions_str
-      +
-          "\" height=\""
-      + dimensions_str + "\">\n"
-      "  <data encoding=\"csv\">";
-}
-
-std::string Mapper::generateTMXTail() { return "</data>\n</layer>\n</map>"; }
+      + "\" tileheight=\"" + tile_height_str + "\" tilecount=\"" + std::to_string(tile_count) + "\" "
+      "columns=\"" + std::to_string(columns) + "\">\n"
+      "  <image source=\"" + tile_set + "\" width=\"" + std::to_string(image_width) + "\" "
+      "height=\"" + std::to_string(image_height) + "\"/>\n"
+      " </tileset>\n";
+}
+
+std::string Mapper::generateLayerHeader(const std::string &layer, const int &width, const int &height) const {
+  return " <layer name=\"" + layer + "\" width=\"" + std::to_string(width)
+      + "\" height=\"" + std::to_string(height) + "\">\n"
+      "  <data encoding=\"" + (base64_ ? "base64" : "csv") + "\""
+      + (compression_ != Compression::NONE
+         ? std::string(" compression=\"") + Compressor::name(compression_) + "\"" : "")
+      + ">";
+}
+
+std::string Mapper::generateLayerTail() const { return "</data>\n</layer>\n"; }
+
+std::string Mapper::generateTMXTail() const { return "</map>"; }
@@ -19,24 +19,59 @@
 #define TMX_TILE_SET_NAME "tmx_tile_set_name"
 #define TMX_TILE_WIDTH "tmx_tile_width"
 #define TMX_TILE_HEIGHT "tmx_tile_height"
+#define TMX_TILE_SET_WIDTH "tmx_tile_set_width"
+#define TMX_TILE_SET_HEIGHT "tmx_tile_set_height"
 #define TMX_GID_DEFAULT "tmx_gid_default"
+#define TMX_AUTOTILE "tmx_autotile"
+#define TMX_ENCODING "tmx_encoding"
+#define TMX_COMPRESSION "tmx_compression"
+#define TMX_SEED "tmx_seed"
+#define TMX_ALGORITHM "tmx_algorithm"
+#define TMX_HEIGHT "tmx_height"
+#define TMX_ANALYZE "tmx_analyze"
+#define TMX_MIN_SOLUTION_RATIO "tmx_min_solution_ratio"
+#define TMX_MAX_DEAD_END_RATIO "tmx_max_dead_end_ratio"
+#define TMX_MAX_ATTEMPTS "tmx_max_attempts"
+#define TMX_SOLUTION_LAYER "tmx_solution_layer"
+#define TMX_SOLUTION_GID "tmx_solution_gid"
 
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_set>
 
 #include "../globals.hxx"
+#include "../analyzer/analyzer.hxx"
 #include "../json/json.hxx"
+#include "../encoder/compressor.hxx"
 #include "../generator/generator.hxx"
+#include "../pool/pool.hxx"
+#include "../stats/stats.hxx"
+#include "../writer/writer.hxx"
+#include "autotile.hxx"
 
 class Mapper {
  public:
+  /// Most tiles along a side of a maze and mazes in a batch, so a typo in
+  /// a config can't ask for more than a machine could ever produce
+  static constexpr int MAX_SIDE = 1 << 24;
+  static constexpr int MAX_AMOUNT = 1 << 20;
+
   /**
    * Constructor
    *
    * @param config JSON config file
+   * @param log    Where progress and errors are written, see setLog()
+   */
+  explicit Mapper(const char *config, std::ostream &log = std::cout);
+
+  /**
+   * Constructor
+   *
+   * @param config Already parsed JSON config
    */
-  explicit Mapper(const char *config);
+  explicit Mapper(const nlohmann::json &config);
 
   /**
    * Destructor
@@ -45,37 +80,219 @@ class Mapper {
 
   /**
    * Using the json config file, this function will generate mazes and map them to GIDs depending on your config.
+   * Mazes are generated in parallel and the call returns once every maze has been saved. The worker threads and
+   * their generators are kept for the next call.
+   *
+   * @param output    The output directory
+   * @param workers   Number of worker threads
+   * @param documents When given, receives the tmx documents in maze order instead of writing any files
+   * @return false if the config is invalid or a maze couldn't be written
+   */
+  bool execute(const std::string &output, int workers, std::vector<std::string> *documents = nullptr);
+
+  /**
+   * Writes tmx documents produced by execute() to the files execute() would have written
+   *
+   * @return false if a file couldn't be written
+   */
+  static bool store(const std::string &output, const std::string &name, const std::vector<std::string> &documents);
+
+  /**
+   * Path of the tmx file of a maze
+   */
+  static std::string path(const std::string &output, const std::string &name, int id);
+
+  /**
+   * Overrides a value of the json config, used for command line options
+   *
+   * @param key   JSON key
+   * @param value The new value
+   */
+  void set(const std::string &key, const nlohmann::json &value);
+
+  /**
+   * The json config
+   */
+  const nlohmann::json &config() const { return j_; }
+
+  /**
+   * Replaces the whole json config
+   */
+  void load(const nlohmann::json &config);
+
+  /**
+   * Sends messages to the given stream instead of stdout
+   */
+  void setLog(std::ostream &log) { log_ = &log; }
+
+  /**
+   * Rough size of the tmx documents the current config produces, assuming
+   * uncompressed layer data
+   *
+   * @return The size in bytes, or the largest size_t if the config is invalid
+   */
+  size_t estimate() const;
+
+  /**
+   * Seed of the last batch
+   */
+  uint64_t seed() const { return seed_; }
+
+  /**
+   * Stats of the config parse and of the last batch
    */
-  std::vector<int>& execute(std::string output);
+  const Stats &stats() const { return stats_; }
 
  private:
   /**
-   * Saves the generated maze to a tmx file that can be opened oin Tiled Map Editor
+   * State owned by a single worker thread and reused for every maze it produces
+   */
+  struct Worker {
+    /// Maze generator and the algorithm it was created for
+    std::unique_ptr<IGenerator> generator;
+    std::string algorithm;
+
+    /// Streaming tmx writer
+    TMXWriter writer;
+
+    /// GIDs of the row being written
+    std::vector<uint32_t> gids;
+
+    /// Little-endian GIDs waiting to be encoded
+    std::vector<uint8_t> raw;
+
+    /// The last rows of a streamed maze, needed to map the row between them
+    BitMatrix window;
+
+    /// Solver and quality metrics
+    Analyzer analyzer;
+  };
+
+  /**
+   * Creates the generator for the configured algorithm
    *
-   * @param maze       Reference to the maze
-   * @param name       Name of the tmx file
-   * @param dimensions The dimensions of the map
-   * @param amount     The amount of mazes to produce
-   * @param dir        The output directory ti save the mazes in
+   * @param width  The width of the first maze
+   * @param height The height of the first maze
+   * @param worker Index of the worker owning the generator
    */
-  void save(matrix &maze, const std::string &name, const int &dimensions,
-            const int &amount, const std::string &dir);
+  std::unique_ptr<IGenerator> createGenerator(int width, int height, int worker) const;
 
   /**
-   * Generate header for tmx file
+   * Generates a maze and saves it to a tmx file that can be opened oin Tiled Map Editor
+   *
+   * @param generator   The generator, already sized and seeded
+   * @param name        Name of the tmx file
+   * @param width       The width of the map
+   * @param height      The height of the map
+   * @param amount      The amount of mazes to produce
+   * @param dir         The output directory ti save the mazes in
+   * @param worker      Index of the worker saving the maze
+   * @param document    When given, receives the tmx document instead of the file
+   * @param stats       Receives the counters and the time spent in every phase
+   * @return false if the file couldn't be written
    */
-  std::string generateTMXHeader(const int &dimensions);
+  bool save(IGenerator &generator, const std::string &name, const int &width,
+            const int &height, const int &amount, const std::string &dir, int worker,
+            std::string *document, MazeStats &stats) const;
 
   /**
-   * Generate tail for tmx file
+   * Width of a maze of the batch, it grows by the increment every
+   * dimensions_repeat mazes
+   *
+   * @param index Index of the maze in the batch, from 0
+   */
+  int64_t mazeWidth(int index) const;
+
+  /**
+   * Height of a maze of the given width, mazes are square unless a fixed
+   * height is given
+   */
+  int64_t mazeHeight(int64_t width) const;
+
+  /**
+   * Creates a directory unless it already exists
+   *
+   * @return false if there is no directory at path afterwards
+   */
+  static bool makeDirectory(const std::string &path);
+
+  /**
+   * Whether an analyzed maze passes the configured filters
+   */
+  bool accept(const Analysis &analysis) const;
+
+  /**
+   * Writes a whole maze as layer data mapped with the given tiles
+   */
+  void writeLayer(const matrix &maze, const AutoTiler &tiles, int worker) const;
+
+  /**
+   * Maps a row of a maze that is in memory as a whole to GIDs
+   */
+  void mapRow(const matrix &maze, int row, const AutoTiler &tiles, uint32_t *gids) const;
+
+  /**
+   * Writes the layer data compressed and base64 encoded. Large layers are
+   * split in chunks which are compressed in parallel.
+   */
+  void writeCompressed(const matrix &maze, const AutoTiler &tiles, int worker) const;
+
+  /**
+   * Generate header for tmx file, up to and including the tile set
    */
-  std::string generateTMXTail();
+  std::string generateTMXHeader(const int &width, const int &height) const;
 
-  /// List of thread instances
-  std::vector<int> threads_;
+  /**
+   * Generate the opening tags of a layer and its data
+   */
+  std::string generateLayerHeader(const std::string &layer, const int &width, const int &height) const;
+
+  /**
+   * Generate the closing tags of a layer
+   */
+  std::string generateLayerTail() const;
+
+  /**
+   * Generate tail for tmx file
+   */
+  std::string generateTMXTail() const;
 
   /// Json parser using nlohmann
   nlohmann::json j_;
+
+  /// Pool and per worker state, kept between batches as long as the amount
+  /// of workers doesn't change
+  std::unique_ptr<WorkerPool> pool_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  int pool_workers_ = 0;
+
+  /// Where messages go, workers lock the mutex before writing
+  std::ostream *log_ = &std::cout;
+  mutable std::mutex log_mutex_;
+
+  /// Generation algorithm
+  std::string algorithm_;
+
+  /// Per phase timings and counters
+  Stats stats_;
+
+  /// Layer data encoding
+  bool base64_ = false;
+  Compression compression_ = Compression::NONE;
+
+  /// Seed of the running batch, used to draw new streams for rejected mazes
+  uint64_t seed_ = 0;
+
+  /// Maze analysis and the filters rejected mazes are regenerated for
+  bool analyze_ = false, filter_ = false;
+  double min_solution_ratio_ = 0, max_dead_end_ratio_ = 1;
+  int max_attempts_ = 10;
+
+  /// Layer of the solution path, no layer is written when empty
+  std::string solution_layer_;
+
+  /// GID mapping of the maze and of the solution path
+  AutoTiler tiles_, solution_tiles_;
 };
 
 #endif /// __MAPPER_HXX__
\ No newline at end of file
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __MATRIX_HXX__
+#define __MATRIX_HXX__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Row-major matrix storing one bit per cell. Every row starts on a fresh
+ * 64-bit word so rows can be processed word-at-a-time without masking the
+ * neighbouring row.
+ */
+class BitMatrix {
+ public:
+  using word = uint64_t;
+
+  /// Amount of cells stored in a single word
+  static constexpr int WORD_BITS = 64;
+
+  /**
+   * Constructor
+   */
+  BitMatrix() = default;
+
+  /**
+   * Constructor, every cell starts cleared
+   *
+   * @param rows Number of rows
+   * @param cols Number of columns
+   */
+  BitMatrix(int rows, int cols) { reshape(rows, cols); }
+
+  /**
+   * Resizes the matrix and clears every cell. Capacity is kept, so the
+   * matrix can be reused for many mazes without reallocating.
+   */
+  void reshape(int rows, int cols) {
+    rows_ = rows;
+    cols_ = cols;
+    stride_ = (cols + WORD_BITS - 1) / WORD_BITS;
+    words_.assign(size_t(rows) * stride_, 0);
+  }
+
+  /**
+   * Clears every cell while keeping the dimensions
+   */
+  void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+  bool get(int row, int col) const {
+    return (words_[index(row, col)] >> (col % WORD_BITS)) & 1u;
+  }
+
+  void set(int row, int col) {
+    words_[index(row, col)] |= word(1) << (col % WORD_BITS);
+  }
+
+  word *row(int row) { return words_.data() + size_t(row) * stride_; }
+  const word *row(int row) const { return words_.data() + size_t(row) * stride_; }
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+
+  /**
+   * Amount of words used by a single row
+   */
+  int stride() const { return stride_; }
+
+ private:
+  size_t index(int row, int col) const {
+    return size_t(row) * stride_ + size_t(col / WORD_BITS);
+  }
+
+  /// The matrix dimensions and words per row
+  int rows_ = 0, cols_ = 0, stride_ = 0;
+
+  /// Packed cell storage
+  std::vector<word> words_;
+};
+
+#endif /// __MATRIX_HXX__
@@ -0,0 +1,154 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "pool.hxx"
+#include <algorithm>
+
+WorkerPool::WorkerPool(int workers) {
+  if (workers < 1) workers = 1;
+
+  for (auto i = 0; i < workers; i++)
+    queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+
+  for (auto i = 0; i < workers; i++)
+    threads_.emplace_back([this, i]() { run(i); });
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+
+  for (auto &thread : threads_) thread.join();
+}
+
+int WorkerPool::defaultWorkers() {
+  const int workers = int(std::thread::hardware_concurrency());
+  return workers > 0 ? workers : 1;
+}
+
+void WorkerPool::submit(Task task) {
+  size_t queue;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue = next_++ % queues_.size();
+    pending_++;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queues_[queue]->mutex);
+    queues_[queue]->tasks.push_back(std::move(task));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_++;
+  }
+  wake_.notify_one();
+}
+
+void WorkerPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t, int)> &body,
+                             int worker) {
+  if (count == 0) return;
+
+  /// Shared with the helper tasks, which can outlive this call when they are
+  /// only picked up after all indices have been claimed
+  struct Loop {
+    std::atomic<size_t> next{0}, done{0};
+    const std::function<void(size_t, int)> *body;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    /// First exception thrown by body, the indices claimed after it are
+    /// skipped
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+  };
+  auto loop = std::make_shared<Loop>();
+  loop->body = &body;
+
+  /// body is only touched after claiming an index, and the caller doesn't
+  /// return before every claimed index is done, even when one of them threw
+  auto work = [loop, count](int w) {
+    for (size_t i = loop->next++; i < count; i = loop->next++) {
+      if (!loop->failed) {
+        try {
+          (*loop->body)(i, w);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(loop->mutex);
+          if (!loop->failed) loop->error = std::current_exception();
+          loop->failed = true;
+        }
+      }
+      if (++loop->done == count) {
+        std::lock_guard<std::mutex> lock(loop->mutex);
+        loop->finished.notify_all();
+      }
+    }
+  };
+
+  const size_t helpers = std::min(count, threads_.size()) - 1;
+  for (size_t i = 0; i < helpers; i++) submit(work);
+
+  work(worker);
+
+  std::unique_lock<std::mutex> lock(loop->mutex);
+  loop->finished.wait(lock, [&]() { return loop->done == count; });
+  if (loop->error) std::rethrow_exception(loop->error);
+}
+
+bool WorkerPool::take(int worker, Task &task) {
+  const size_t count = queues_.size();
+
+  /// Own queue first, oldest task first
+  for (size_t i = 0; i < count; i++) {
+    auto &queue = *queues_[(worker + i) % count];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) continue;
+
+    /// Steal from the back so the owner and the thief don't fight over the
+    /// same end of the queue
+    if (i == 0) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    } else {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    return true;
+  }
+
+  return false;
+}
+
+void WorkerPool::run(int worker) {
+  Task task;
+
+  while (true) {
+    if (take(worker, task)) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_--;
+      }
+
+      task(worker);
+      task = nullptr;
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--pending_ == 0) done_.notify_all();
+      continue;
+    }
+
+    /// Nothing to do, sleep until a task is queued
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+    if (stop_ && queued_ <= 0) return;
+  }
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __POOL_HXX__
+#define __POOL_HXX__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed size pool of worker threads. Every worker owns a queue, tasks are
+ * handed out round-robin and an idle worker steals from the back of the other
+ * queues, so a few large mazes can't hold up the rest of the batch.
+ */
+class WorkerPool {
+ public:
+  /**
+   * A task receives the index of the worker running it, which can be used to
+   * look up per-worker state without any locking.
+   */
+  using Task = std::function<void(int /* worker */)>;
+
+  /**
+   * Constructor
+   *
+   * @param workers Number of worker threads, at least one is always started
+   */
+  explicit WorkerPool(int workers);
+
+  /**
+   * Destructor, finishes the queued tasks and joins all workers
+   */
+  ~WorkerPool();
+
+  /**
+   * Queues a task
+   */
+  void submit(Task task);
+
+  /**
+   * Blocks until every submitted task has finished
+   */
+  void wait();
+
+  /**
+   * Runs body(index, worker) for every index in [0, count) and returns once
+   * all of them are done. The calling thread takes part in the work, so this
+   * can be called from inside a task without deadlocking the pool. If body
+   * throws, the remaining indices are skipped and the first exception is
+   * rethrown here once no thread runs body anymore.
+   *
+   * @param count  Amount of indices
+   * @param body   Function to run for every index
+   * @param worker Worker index of the calling thread
+   */
+  void parallelFor(size_t count, const std::function<void(size_t, int)> &body, int worker);
+
+  /**
+   * Number of worker threads
+   */
+  int size() const { return int(threads_.size()); }
+
+  /**
+   * Default amount of workers, one per hardware thread
+   */
+  static int defaultWorkers();
+
+ private:
+  /// A worker's own queue
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  /**
+   * Worker loop
+   */
+  void run(int worker);
+
+  /**
+   * Takes a task from the worker's own queue or steals one from another
+   */
+  bool take(int worker, Task &task);
+
+  /// Per worker queues
+  std::vector<std::unique_ptr<Queue>> queues_;
+
+  /// Worker threads
+  std::vector<std::thread> threads_;
+
+  /// Guards the counters below
+  std::mutex mutex_;
+
+  /// Signalled when work is queued and when the last task finishes
+  std::condition_variable wake_, done_;
+
+  /// Tasks sitting in a queue and tasks not finished yet
+  long queued_ = 0, pending_ = 0;
+
+  /// Queue the next task is submitted to
+  size_t next_ = 0;
+
+  /// Set when the pool shuts down
+  bool stop_ = false;
+};
+
+#endif /// __POOL_HXX__
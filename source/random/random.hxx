@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __RANDOM_HXX__
+#define __RANDOM_HXX__
+
+#include <cstdint>
+
+/**
+ * SplitMix64 random number generator. Its output is a bijective mix of a
+ * counter, so every (seed, stream) pair gives an independent, reproducible
+ * sequence no matter which thread uses it or in what order streams are used.
+ */
+class Random {
+ public:
+  /**
+   * Constructor
+   *
+   * @param seed   Seed shared by every stream
+   * @param stream Index of the stream, e.g. the maze number in a batch
+   */
+  explicit Random(uint64_t seed = 0, uint64_t stream = 0) { reset(seed, stream); }
+
+  /**
+   * Restarts the generator on the given stream
+   */
+  void reset(uint64_t seed, uint64_t stream) {
+    /// Mixing the stream index first keeps neighbouring streams of the same
+    /// seed far apart in the counter sequence
+    state_ = mix(seed ^ mix(stream + GOLDEN_GAMMA));
+  }
+
+  /**
+   * Next 64 random bits
+   */
+  uint64_t next() { return mix(state_ += GOLDEN_GAMMA); }
+
+  /**
+   * Random number in [0, bound) using a single multiply instead of a modulo.
+   * The bias is below bound / 2^32, far too small to matter for bound <= 4.
+   */
+  uint32_t bounded(uint32_t bound) {
+    return uint32_t((uint64_t(uint32_t(next() >> 32)) * bound) >> 32);
+  }
+
+  /**
+   * SplitMix64 finalizer
+   */
+  static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+ private:
+  /// Counter increment, 2^64 divided by the golden ratio
+  static constexpr uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+  /// The counter
+  uint64_t state_ = 0;
+};
+
+#endif /// __RANDOM_HXX__
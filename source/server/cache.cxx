@@ -0,0 +1,34 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "cache.hxx"
+
+ReuseCache::ReuseCache(size_t capacity) : capacity_(capacity) {}
+
+std::shared_ptr<const ReuseCache::Documents> ReuseCache::get(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto found = index_.find(key);
+  if (found == index_.end()) return nullptr;
+
+  entries_.splice(entries_.begin(), entries_, found->second);
+  return found->second->documents;
+}
+
+void ReuseCache::put(const std::string &key, std::shared_ptr<const Documents> documents) {
+  size_t bytes = key.size();
+  for (const auto &document : *documents) bytes += document.size();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > capacity_ || index_.count(key)) return;
+
+  while (bytes_ + bytes > capacity_) {
+    bytes_ -= entries_.back().bytes;
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+
+  entries_.push_front({key, std::move(documents), bytes});
+  index_[key] = entries_.begin();
+  bytes_ += bytes;
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __CACHE_HXX__
+#define __CACHE_HXX__
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Least recently used cache of generated tmx documents, bounded by the size
+ * of the documents it holds. Documents are shared, so an entry can be evicted
+ * while a job is still sending it.
+ */
+class ReuseCache {
+ public:
+  using Documents = std::vector<std::string>;
+
+  /**
+   * Constructor
+   *
+   * @param capacity Most bytes of documents kept, 0 disables the cache
+   */
+  explicit ReuseCache(size_t capacity);
+
+  /**
+   * Looks a batch up and marks it as recently used
+   *
+   * @return nullptr if the batch isn't cached
+   */
+  std::shared_ptr<const Documents> get(const std::string &key);
+
+  /**
+   * Adds a batch, evicting the least recently used ones to make room.
+   * Batches larger than the whole cache aren't kept.
+   */
+  void put(const std::string &key, std::shared_ptr<const Documents> documents);
+
+  /**
+   * Whether the cache keeps anything at all
+   */
+  bool enabled() const { return capacity_ > 0; }
+
+  /**
+   * Most bytes of documents kept
+   */
+  size_t capacity() const { return capacity_; }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const Documents> documents;
+    size_t bytes;
+  };
+
+  /// Entries from most to least recently used
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+
+  /// Most and current bytes of documents
+  size_t capacity_, bytes_ = 0;
+
+  /// Jobs of different connections share the cache
+  std::mutex mutex_;
+};
+
+#endif /// __CACHE_HXX__
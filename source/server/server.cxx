@@ -0,0 +1,236 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "server.hxx"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../stats/stats.hxx"
+
+namespace {
+/// Short hands for config keys
+const std::pair<const char *, const char *> ALIASES[] = {
+    {"seed", TMX_SEED}, {"width", TMX_DIMENSIONS}, {"height", TMX_HEIGHT}, {"amount", TMX_AMOUNT},
+    {"name", TMX_NAME}, {"encoding", TMX_ENCODING}, {"compression", TMX_COMPRESSION},
+    {"algorithm", TMX_ALGORITHM}};
+
+/// Writes all of data to a file descriptor
+bool writeAll(int fd, const std::string &data) {
+  size_t done = 0;
+  while (done < data.size()) {
+    const ssize_t size = ::write(fd, data.data() + done, data.size() - done);
+    if (size < 0 && errno == EINTR) continue;
+    if (size <= 0) return false;
+    done += size_t(size);
+  }
+  return true;
+}
+}
+
+constexpr size_t JobServer::MAX_LINE;
+
+JobServer::JobServer(Mapper &mapper, const std::string &output, int workers, size_t cache)
+    : config_(mapper.config()), output_(output), workers_(workers), cache_(cache), mapper_(mapper) {}
+
+void JobServer::serve(std::istream &in, std::ostream &out) {
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    out << run(line) << std::endl;
+  }
+}
+
+bool JobServer::listen(const std::string &path) {
+  sockaddr_un address{};
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  /// Clients going away must not take the server down with them
+  std::signal(SIGPIPE, SIG_IGN);
+
+  /// A socket left behind by an earlier server is replaced, anything else
+  /// at the path is left alone
+  struct stat info{};
+  if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) unlink(path.c_str());
+
+  const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0) return false;
+  if (bind(server, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+      || ::listen(server, SOMAXCONN) != 0) {
+    close(server);
+    return false;
+  }
+
+  for (;;) {
+    const int client = accept(server, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      break;
+    }
+    std::thread([this, client]() { handle(client); }).detach();
+  }
+
+  close(server);
+  return false;
+}
+
+void JobServer::handle(int client) {
+  std::string pending;
+  char buffer[1 << 16];
+
+  /// Set while the rest of a line that was too long is thrown away
+  bool skipping = false;
+  const std::string too_long =
+      nlohmann::json({{"ok", false}, {"error", "a job can't be longer than " + std::to_string(MAX_LINE) + " bytes"}})
+          .dump() + "\n";
+
+  for (;;) {
+    const ssize_t size = ::read(client, buffer, sizeof(buffer));
+    if (size < 0 && errno == EINTR) continue;
+    if (size <= 0) break;
+    pending.append(buffer, size_t(size));
+
+    /// Run every complete line, keep the rest for the next read
+    size_t start = 0, end;
+    while ((end = pending.find('\n', start)) != std::string::npos) {
+      const std::string line = pending.substr(start, end - start);
+      start = end + 1;
+      if (skipping) {
+        skipping = false;
+        continue;
+      }
+      if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+      if (!writeAll(client, line.size() > MAX_LINE ? too_long : run(line) + "\n")) {
+        close(client);
+        return;
+      }
+    }
+    pending.erase(0, start);
+
+    /// A client that never ends its line can't make the buffer grow forever
+    if (pending.size() > MAX_LINE) {
+      pending.clear();
+      if (!skipping && !writeAll(client, too_long)) break;
+      skipping = true;
+    }
+  }
+
+  close(client);
+}
+
+std::string JobServer::run(const std::string &line) {
+  const Stopwatch elapsed;
+  nlohmann::json response = nlohmann::json::object();
+
+  try {
+    const nlohmann::json request = nlohmann::json::parse(line);
+    if (!request.is_object()) throw std::runtime_error("a job must be a JSON object");
+    if (request.count("id")) response["id"] = request.at("id");
+    run(request, response);
+    response["ok"] = true;
+  } catch (const std::exception &e) {
+    response["ok"] = false;
+    response["error"] = e.what();
+  }
+
+  response["seconds"] = elapsed.seconds();
+  return response.dump();
+}
+
+void JobServer::run(const nlohmann::json &request, nlohmann::json &response) {
+  nlohmann::json config = config_.is_object() ? config_ : nlohmann::json::object();
+  std::string output = output_;
+  bool inline_documents = false;
+
+  for (auto entry = request.begin(); entry != request.end(); ++entry) {
+    const std::string &key = entry.key();
+    if (key == "id") continue;
+
+    if (key == "output") {
+      output = entry.value().get<std::string>();
+    } else if (key == "inline") {
+      inline_documents = entry.value().get<bool>();
+    } else if (key == "size" && entry.value().is_array()) {
+      if (entry.value().size() != 2) throw std::runtime_error("size must be a number or [width, height]");
+      config[TMX_DIMENSIONS] = entry.value()[0];
+      config[TMX_HEIGHT] = entry.value()[1];
+    } else if (key == "size") {
+      config[TMX_DIMENSIONS] = entry.value();
+    } else if (key.compare(0, 4, "tmx_") == 0) {
+      config[key] = entry.value();
+    } else {
+      bool known = false;
+      for (const auto &alias : ALIASES) {
+        if (key != alias.first) continue;
+        config[alias.second] = entry.value();
+        known = true;
+      }
+      if (!known) throw std::runtime_error("unknown key \"" + key + "\"");
+    }
+  }
+
+  /// A batch is cached by everything that goes into it, only seeded batches
+  /// come out the same twice
+  const bool cacheable = cache_.enabled() && config.count(TMX_SEED);
+  const std::string key = cacheable ? config.dump() : std::string();
+  std::shared_ptr<const ReuseCache::Documents> documents = cacheable ? cache_.get(key) : nullptr;
+  response["cached"] = documents != nullptr;
+
+  /// Batches go straight to disk unless they are sent back or could fit
+  /// in the cache
+  bool in_memory = documents != nullptr || inline_documents;
+  size_t count = documents != nullptr ? documents->size() : 0;
+
+  if (documents != nullptr) {
+    response["seed"] = config.at(TMX_SEED);
+  } else {
+    /// The mapper and its pool run one job at a time, each spread over all
+    /// the workers
+    std::lock_guard<std::mutex> lock(mutex_);
+    log_.str(std::string());
+    mapper_.setLog(log_);
+    mapper_.load(config);
+
+    const bool cached = cacheable && mapper_.estimate() <= cache_.capacity();
+    in_memory = in_memory || cached;
+    std::shared_ptr<ReuseCache::Documents> generated;
+    if (in_memory) generated = std::make_shared<ReuseCache::Documents>();
+
+    if (!mapper_.execute(output, workers_, generated.get())) {
+      /// Only the messages, not the progress lines, make the error
+      std::string error, line;
+      std::istringstream messages(log_.str());
+      while (std::getline(messages, line)) {
+        if (line.empty() || line.compare(0, 6, "######") == 0) continue;
+        line.erase(line.find_last_not_of(" :(") + 1);
+        error += (error.empty() ? "" : ", ") + line;
+      }
+      throw std::runtime_error(error.empty() ? "the job failed" : error);
+    }
+    response["seed"] = mapper_.seed();
+
+    count = size_t(std::max(0, int(config.at(TMX_AMOUNT))));
+    if (cached) cache_.put(key, generated);
+    documents = generated;
+  }
+
+  if (inline_documents) {
+    response["mazes"] = *documents;
+    return;
+  }
+
+  const std::string name = config.at(TMX_NAME);
+  if (in_memory && !Mapper::store(output, name, *documents))
+    throw std::runtime_error("output directory \"" + output + "\" can't be written");
+
+  response["files"] = nlohmann::json::array();
+  for (size_t i = 0; i < count; i++) response["files"].push_back(Mapper::path(output, name, int(i + 1)));
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __SERVER_HXX__
+#define __SERVER_HXX__
+
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "../json/json.hxx"
+#include "../mapper/mapper.hxx"
+#include "cache.hxx"
+
+/**
+ * Runs jobs for a long running generator. Jobs are JSON objects, one per
+ * line, holding the config keys that differ from the base config and a few
+ * short hands: "seed", "size" (a number or [width, height]), "width",
+ * "height", "amount", "name", "encoding", "compression" and "algorithm".
+ * "output" overrides the output directory, "inline" returns the tmx documents
+ * instead of writing files and "id" is echoed back.
+ *
+ * Every job gets a single line JSON response with "ok" and either "files" or
+ * "mazes", or an "error". All jobs share the mapper's worker pool and warm
+ * generators, so they run one at a time with every worker on the current
+ * one. Seeded jobs are kept in a cache so repeating them costs a lookup.
+ */
+class JobServer {
+ public:
+  /// Longest job line a socket client may send, a longer one is answered
+  /// with an error and skipped instead of being buffered
+  static constexpr size_t MAX_LINE = 1 << 20;
+
+  /**
+   * Constructor
+   *
+   * @param mapper  The mapper running the jobs, its config is the base config of every job
+   * @param output  Default output directory
+   * @param workers Number of worker threads
+   * @param cache   Most bytes of tmx documents kept for repeated jobs
+   */
+  JobServer(Mapper &mapper, const std::string &output, int workers, size_t cache);
+
+  /**
+   * Runs the jobs read from in until it ends, responses go to out
+   */
+  void serve(std::istream &in, std::ostream &out);
+
+  /**
+   * Serves every connection to a unix domain socket on its own thread
+   *
+   * @return false if the socket couldn't be set up
+   */
+  bool listen(const std::string &path);
+
+  /**
+   * Runs a single job
+   *
+   * @param line The job
+   * @return The response, without a new line
+   */
+  std::string run(const std::string &line);
+
+ private:
+  /**
+   * Runs a parsed job and fills the response
+   */
+  void run(const nlohmann::json &request, nlohmann::json &response);
+
+  /**
+   * Serves the jobs of a connection until it closes
+   */
+  void handle(int client);
+
+  /// The base config, taken from the mapper
+  const nlohmann::json config_;
+
+  /// Default output directory and amount of workers
+  const std::string output_;
+  const int workers_;
+
+  /// Batches of seeded jobs
+  ReuseCache cache_;
+
+  /// Runs the jobs one at a time, along with its messages
+  Mapper &mapper_;
+  std::ostringstream log_;
+  std::mutex mutex_;
+};
+
+#endif /// __SERVER_HXX__
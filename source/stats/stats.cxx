@@ -0,0 +1,155 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "stats.hxx"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <sys/resource.h>
+
+#include "../json/json.hxx"
+
+namespace {
+/// Value at the given percentile of sorted values, nearest rank
+double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) return 0;
+  const size_t rank = size_t(p / 100.0 * double(sorted.size()) + 0.5);
+  return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+nlohmann::json toJson(const MazeStats &maze) {
+  nlohmann::json json = {
+      {"id", maze.id}, {"width", maze.width}, {"height", maze.height}, {"worker", maze.worker},
+      {"cells", maze.cells}, {"backtracks", maze.backtracks}, {"bytes", maze.bytes},
+      {"allocate_seconds", maze.allocate}, {"carve_seconds", maze.carve}, {"analyze_seconds", maze.analyze},
+      {"serialize_seconds", maze.serialize}, {"write_seconds", maze.write}, {"latency_seconds", maze.latency}};
+
+  if (maze.attempts > 0)
+    json["analysis"] = {{"attempts", maze.attempts}, {"perfect", maze.perfect}, {"solution", maze.solution},
+                        {"dead_ends", maze.dead_ends}, {"junctions", maze.junctions},
+                        {"branching", maze.branching}, {"longest_corridor", maze.longest_corridor}};
+  return json;
+}
+}
+
+void Stats::begin(int workers) {
+  mazes_.assign(size_t(workers), std::vector<MazeStats>());
+  wall_ = 0;
+  batch_.restart();
+}
+
+long Stats::peakRSS() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line))
+    if (line.compare(0, 6, "VmHWM:") == 0) return std::atol(line.c_str() + 6);
+
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+void Stats::report(std::ostream &out, bool json) const {
+  /// Aggregate everything up front, both formats share it
+  std::vector<MazeStats> mazes;
+  std::vector<double> busy(mazes_.size(), 0), latencies;
+  MazeStats total;
+  double tiles = 0;
+  int analyzed = 0;
+
+  for (size_t worker = 0; worker < mazes_.size(); worker++) {
+    for (const auto &maze : mazes_[worker]) {
+      mazes.push_back(maze);
+      latencies.push_back(maze.latency);
+      busy[worker] += maze.latency;
+      tiles += double(maze.width) * double(maze.height);
+
+      total.cells += maze.cells;
+      total.backtracks += maze.backtracks;
+      total.bytes += maze.bytes;
+      total.allocate += maze.allocate;
+      total.carve += maze.carve;
+      total.analyze += maze.analyze;
+      total.attempts += maze.attempts;
+      if (maze.attempts > 0) analyzed++;
+      total.serialize += maze.serialize;
+      total.write += maze.write;
+    }
+  }
+
+  std::sort(mazes.begin(), mazes.end(), [](const MazeStats &a, const MazeStats &b) { return a.id < b.id; });
+  std::sort(latencies.begin(), latencies.end());
+
+  const double wall = wall_ > 0 ? wall_ : 1e-9;
+  const long rss = peakRSS();
+
+  if (json) {
+    nlohmann::json report;
+    report["parse_seconds"] = parse_;
+    report["wall_seconds"] = wall_;
+    report["peak_rss_kb"] = rss;
+    report["aggregate"] = {
+        {"mazes", mazes.size()}, {"tiles", tiles}, {"cells", total.cells},
+        {"backtracks", total.backtracks}, {"bytes", total.bytes},
+        {"mazes_per_second", double(mazes.size()) / wall}, {"tiles_per_second", tiles / wall},
+        {"bytes_per_second", double(total.bytes) / wall},
+        {"latency_p50_seconds", percentile(latencies, 50)},
+        {"latency_p99_seconds", percentile(latencies, 99)},
+        {"latency_max_seconds", latencies.empty() ? 0.0 : latencies.back()},
+        {"allocate_seconds", total.allocate}, {"carve_seconds", total.carve},
+        {"analyze_seconds", total.analyze}, {"rejected", total.attempts - analyzed},
+        {"serialize_seconds", total.serialize}, {"write_seconds", total.write}};
+
+    report["workers"] = nlohmann::json::array();
+    for (size_t worker = 0; worker < mazes_.size(); worker++)
+      report["workers"].push_back({{"worker", worker}, {"mazes", mazes_[worker].size()},
+                                   {"busy_seconds", busy[worker]}, {"utilisation", busy[worker] / wall}});
+
+    report["mazes"] = nlohmann::json::array();
+    for (const auto &maze : mazes) report["mazes"].push_back(toJson(maze));
+
+    out << report.dump(2) << std::endl;
+    return;
+  }
+
+  const auto ms = [](double seconds) { return seconds * 1000.0; };
+  const double phases = std::max(1e-12, total.allocate + total.carve + total.analyze + total.serialize + total.write);
+
+  out << std::fixed << std::setprecision(3)
+      << "###### Stats" << std::endl
+      << "  config parse   " << ms(parse_) << " ms" << std::endl
+      << "  mazes          " << mazes.size() << " in " << ms(wall_) << " ms, " << double(mazes.size()) / wall
+      << " mazes/s, " << tiles / wall / 1e6 << " Mtiles/s, " << double(total.bytes) / wall / (1 << 20)
+      << " MB/s" << std::endl
+      << "  latency        p50 " << ms(percentile(latencies, 50)) << " ms, p99 "
+      << ms(percentile(latencies, 99)) << " ms, max " << ms(latencies.empty() ? 0 : latencies.back())
+      << " ms" << std::endl
+      << "  phases         allocate " << 100 * total.allocate / phases << "%, carve "
+      << 100 * total.carve / phases << "%, analyze " << 100 * total.analyze / phases << "%, serialize "
+      << 100 * total.serialize / phases << "%, write " << 100 * total.write / phases << "%" << std::endl
+      << "  work           " << total.cells << " cells carved, " << total.backtracks << " backtracks, "
+      << total.bytes << " bytes written, " << total.attempts - analyzed << " mazes rejected" << std::endl
+      << "  peak rss       " << rss << " KB" << std::endl;
+
+  for (size_t worker = 0; worker < mazes_.size(); worker++)
+    out << "  worker " << std::setw(3) << worker << "     " << mazes_[worker].size() << " mazes, busy "
+        << ms(busy[worker]) << " ms (" << 100 * busy[worker] / wall << "%)" << std::endl;
+
+  for (const auto &maze : mazes) {
+    out << "  maze " << std::setw(5) << maze.id << "     " << maze.width << "x" << maze.height << " on worker "
+        << maze.worker << ": " << ms(maze.latency) << " ms (allocate " << ms(maze.allocate) << ", carve "
+        << ms(maze.carve) << ", analyze " << ms(maze.analyze) << ", serialize " << ms(maze.serialize)
+        << ", write " << ms(maze.write) << "), " << maze.cells << " cells, " << maze.backtracks << " backtracks, " << maze.bytes << " bytes"
+        << std::endl;
+
+    if (maze.attempts > 0)
+      out << "                 " << (maze.perfect ? "perfect" : "not perfect") << " after " << maze.attempts
+          << " attempts, solution " << maze.solution << " tiles, " << maze.dead_ends << " dead ends, "
+          << maze.junctions << " junctions branching " << maze.branching << " ways, longest corridor "
+          << maze.longest_corridor << std::endl;
+  }
+
+  out << std::defaultfloat;
+}
@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __STATS_HXX__
+#define __STATS_HXX__
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+/**
+ * Measures the time elapsed since it was created or restarted
+ */
+class Stopwatch {
+ public:
+  Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+  void restart() { start_ = std::chrono::steady_clock::now(); }
+
+  double seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * What it took to produce a single maze. Times are in seconds.
+ */
+struct MazeStats {
+  int id = 0, width = 0, height = 0, worker = 0;
+
+  /// Cells carved, dead ends backed out of and bytes written to the tmx file
+  uint64_t cells = 0, backtracks = 0, bytes = 0;
+
+  /// Time per phase, and from the worker picking the maze up to the file being closed
+  double allocate = 0, carve = 0, analyze = 0, serialize = 0, write = 0, latency = 0;
+
+  /// Mazes generated to get one through the filters, 0 when not analyzed
+  int attempts = 0;
+
+  /// Metrics of the kept maze, see Analysis
+  bool perfect = false;
+  uint64_t solution = 0, dead_ends = 0, junctions = 0, longest_corridor = 0;
+  double branching = 0;
+};
+
+/**
+ * Collects the stats of a batch. Every worker appends to its own list, so
+ * recording a maze never takes a lock and the stats can stay on all the time.
+ */
+class Stats {
+ public:
+  /**
+   * Records the time spent reading and parsing the config
+   */
+  void setParse(double seconds) { parse_ = seconds; }
+
+  /**
+   * Starts a batch running on the given amount of workers
+   */
+  void begin(int workers);
+
+  /**
+   * Ends the batch
+   */
+  void end() { wall_ = batch_.seconds(); }
+
+  /**
+   * Records a maze, must only be called from the worker that produced it
+   */
+  void add(const MazeStats &maze) { mazes_[maze.worker].push_back(maze); }
+
+  /**
+   * Prints a per maze and aggregate report, as text or as JSON
+   */
+  void report(std::ostream &out, bool json) const;
+
+  /**
+   * Peak resident set size of the process in KB
+   */
+  static long peakRSS();
+
+ private:
+  /// Time spent parsing the config and running the batch
+  double parse_ = 0, wall_ = 0;
+
+  /// Started when the batch begins
+  Stopwatch batch_;
+
+  /// Mazes produced by every worker
+  std::vector<std::vector<MazeStats>> mazes_;
+};
+
+#endif /// __STATS_HXX__
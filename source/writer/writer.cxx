@@ -0,0 +1,145 @@
+/// Copyright (c) 2017 Mozart Louis
+/// This code is licensed under MIT license (see LICENSE.txt for details)
+
+#include "writer.hxx"
+#include <cstring>
+
+#include "../stats/stats.hxx"
+
+namespace {
+/// Longest decimal uint32 plus the separator
+const size_t MAX_CELL = 11;
+
+/// "00" to "99", used to format two digits at a time
+const char DIGITS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+}
+
+TMXWriter::TMXWriter(size_t buffer_size) : buffer_(buffer_size < 64 ? 64 : buffer_size) {}
+
+TMXWriter::~TMXWriter() { close(); }
+
+bool TMXWriter::open(const std::string &path) {
+  close();
+
+  used_ = 0;
+  written_ = 0;
+  write_seconds_ = 0;
+  failed_ = false;
+  file_ = std::fopen(path.c_str(), "wb");
+
+  /// We do our own buffering, the stdio one would only add a copy
+  if (file_ != nullptr) std::setvbuf(file_, nullptr, _IONBF, 0);
+  return file_ != nullptr;
+}
+
+void TMXWriter::capture(std::string &target) {
+  close();
+
+  used_ = 0;
+  written_ = 0;
+  write_seconds_ = 0;
+  failed_ = false;
+  target.clear();
+  target_ = &target;
+}
+
+bool TMXWriter::close() {
+  if (target_ != nullptr) {
+    flush();
+    target_ = nullptr;
+    return !failed_;
+  }
+  if (file_ == nullptr) return false;
+
+  flush();
+  const Stopwatch write;
+  if (std::fclose(file_) != 0) failed_ = true;
+  write_seconds_ += write.seconds();
+  file_ = nullptr;
+
+  return !failed_;
+}
+
+void TMXWriter::flush() {
+  if (used_ == 0) return;
+
+  const Stopwatch write;
+  if (target_ != nullptr) target_->append(buffer_.data(), used_);
+  else if (file_ == nullptr || std::fwrite(buffer_.data(), 1, used_, file_) != used_)
+    failed_ = true;
+  write_seconds_ += write.seconds();
+
+  written_ += used_;
+  used_ = 0;
+}
+
+void TMXWriter::write(const char *data, size_t size) {
+  /// Large blocks skip the buffer altogether
+  if (size >= buffer_.size()) {
+    flush();
+    const Stopwatch write;
+    if (target_ != nullptr) target_->append(data, size);
+    else if (file_ == nullptr || std::fwrite(data, 1, size, file_) != size) failed_ = true;
+    write_seconds_ += write.seconds();
+    written_ += size;
+    return;
+  }
+
+  if (used_ + size > buffer_.size()) flush();
+  std::memcpy(buffer_.data() + used_, data, size);
+  used_ += size;
+}
+
+void TMXWriter::writeCSVRow(const uint32_t *gids, size_t count, bool last) {
+  for (size_t i = 0; i < count; i++) {
+    if (used_ + MAX_CELL + 1 > buffer_.size()) flush();
+
+    char *out = formatUInt(buffer_.data() + used_, gids[i]);
+    if (i + 1 < count || !last) *out++ = ',';
+    used_ = size_t(out - buffer_.data());
+  }
+
+  if (used_ + 1 > buffer_.size()) flush();
+  buffer_[used_++] = '\n';
+}
+
+char *TMXWriter::formatUInt(char *out, uint32_t value) {
+  /// Most tiles are single digit GIDs or empty
+  if (value < 10) {
+    *out = char('0' + value);
+    return out + 1;
+  }
+
+  /// Format from the back two digits at a time, then move into place
+  char digits[10];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+
+  while (value >= 100) {
+    const uint32_t pair = (value % 100) * 2;
+    value /= 100;
+    *--p = DIGITS[pair + 1];
+    *--p = DIGITS[pair];
+  }
+
+  if (value >= 10) {
+    *--p = DIGITS[value * 2 + 1];
+    *--p = DIGITS[value * 2];
+  } else {
+    *--p = char('0' + value);
+  }
+
+  const size_t length = size_t(end - p);
+  std::memcpy(out, p, length);
+  return out + length;
+}
@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2017 Mozart Louis
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ */
+
+#ifndef __WRITER_HXX__
+#define __WRITER_HXX__
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Streams a tmx file to disk through a fixed size buffer. The buffer is
+ * allocated once, so a writer can be reused for any amount of maps of any
+ * size without its memory growing.
+ */
+class TMXWriter {
+ public:
+  /// Default size of the output buffer
+  static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+  /**
+   * Constructor
+   *
+   * @param buffer_size Size of the output buffer in bytes
+   */
+  explicit TMXWriter(size_t buffer_size = BUFFER_SIZE);
+
+  /**
+   * Destructor, closes the file if it is still open
+   */
+  ~TMXWriter();
+
+  TMXWriter(const TMXWriter &) = delete;
+  TMXWriter &operator=(const TMXWriter &) = delete;
+
+  /**
+   * Opens the output file, truncating it
+   *
+   * @return false if the file couldn't be opened
+   */
+  bool open(const std::string &path);
+
+  /**
+   * Writes into a string instead of a file until the writer is closed or
+   * opened again, the string is cleared first
+   */
+  void capture(std::string &target);
+
+  /**
+   * Flushes the buffer and closes the file
+   *
+   * @return false if any write failed
+   */
+  bool close();
+
+  /**
+   * Appends raw bytes
+   */
+  void write(const char *data, size_t size);
+
+  /**
+   * Appends a string
+   */
+  void write(const std::string &data) { write(data.data(), data.size()); }
+
+  /**
+   * Appends a row of GIDs in Tiled's csv format. Every row but the last ends
+   * with a comma, every row ends with a new line.
+   *
+   * @param gids  The GIDs of the row
+   * @param count Amount of GIDs in the row
+   * @param last  Whether this is the last row of the layer
+   */
+  void writeCSVRow(const uint32_t *gids, size_t count, bool last);
+
+  /**
+   * Amount of bytes written since the file was opened
+   */
+  size_t written() const { return written_ + used_; }
+
+  /**
+   * Seconds spent handing data to the file since it was opened
+   */
+  double writeSeconds() const { return write_seconds_; }
+
+  /**
+   * Formats value in decimal at out without a terminator
+   *
+   * @return Pointer past the last written character
+   */
+  static char *formatUInt(char *out, uint32_t value);
+
+ private:
+  /**
+   * Writes the buffered bytes to the file
+   */
+  void flush();
+
+  /// Output buffer
+  std::vector<char> buffer_;
+
+  /// Amount of buffered bytes and amount of bytes already flushed
+  size_t used_ = 0, written_ = 0;
+
+  /// Time spent in fwrite and fclose
+  double write_seconds_ = 0;
+
+  /// The output file, or the string being written into
+  std::FILE *file_ = nullptr;
+  std::string *target_ = nullptr;
+
+  /// Set when a write failed
+  bool failed_ = false;
+};
+
+#endif /// __WRITER_HXX__